@@ -17,6 +17,9 @@
 //#define USE_ASSERT
 #define USE_TRACE
 //#define USE_CONSOLE
+//#define USE_ISR_LATENCY     // measure timer interrupts latency, print it periodically
+//#define USE_INPUT_RECORDER  // record input edges and gestures, dump and replay them
+//#define USE_ENERGY_METER    // integrate loads on-time, print charge [mAh] of each load
 
 
 // ****************************************************************************
@@ -33,6 +36,7 @@
       
     // System clock
     #define BSP_SYS_CLK_HZ    1000000UL
+    #define CLOCK_SCALING_ENABLED   // system clock prescaller is switched at runtime (bsp_clock.h)
 
     #ifndef F_CPU
         #error "ERROR: F_CPU must be defined in project settings"
@@ -108,6 +112,8 @@
 		
     
     // BUTTONS
+    #define BTNS_PIN              PINC    // all buttons are read at once
+    
     // BTN 0 - PC0 - (pin A0) - Helmet
     #define BTN0_PORT             PORTC
     #define BTN0_PIN              PINC
@@ -138,19 +144,47 @@
         
        
     // EXT INT
-    #define EXTINT0_ENABLED       // PD2 for RF RX signal
+    //#define EXTINT0_ENABLED     // PD2 for RF RX signal (not used: buttons are captured by PCINT1)
+    #define PCINT1_ENABLED        // PC0..PC3 for RF RX data (buttons edges capture)
+    //#define RFRX_ENABLED        // PD2 for OOK data of plain RF receiver (EV1527/PT2262 decoder), 
+                                  // EXTINT0_ENABLED must be disabled
+    //#define RCIN_ENABLED        // PC0..PC3 for pulses of RC receiver channels 0..3,
+                                  // PCINT1_ENABLED must be disabled
     
         
     // ADC
     #define ADC5_ENABLED          // PC5 for battery voltage
+    #define BATTERY_ENABLED       // LED5 powers battery divider, ADC5 measures it (bsp_battery.h)
+    //#define ADC_SCAN_ENABLED    // channels are measured in turn, one per time base frame (bsp_adc.h),
+                                  // ADC is enabled all the time
+    #define ADC_SCAN_CHANNELS     { BSP_ADC_CHANNEL_TEMP }   // servo current and light sensor are not wired yet
            
            
     // PWM
                                       
                                
     // TIMERS
-    #define SWTIMERS_MAX          1 // number of timers
-    #define TMR_BTN_CHECK         0
+    #define TIMER_TICKLESS_ENABLED  // hw-timer interrupts only at software timer deadlines
+    #define SWTIMERS_MAX_TIME     60000UL // the longest timeout [ms] (16-bit counters)
+    #define TIMEBASE_ENABLED        // Timer 1 counts microseconds (timestamps, servo frames)
+    #define TMR_GESTURE           0
+    #define TMR_FAILSAFE          1
+    #define TMR_REPLAY            2
+    #define TMR_BATTERY           3
+    #define TMR_HELMET            4 // async: servo positions are stepped in timer ISR
+    #define TMR_RFRX_NOISE        5 // async: RF decoder interrupt is masked after noise burst
+    #define TMR_REMOTE_LEARN      6 // RF codes learning timeout
+#ifdef USE_ISR_LATENCY
+    #define TMR_LATENCY_DUMP      7
+    #define SWTIMERS_MAX          8 // number of timers
+#else
+    #define SWTIMERS_MAX          7 // number of timers
+#endif
+
+
+    // AMBIENT ANIMATION (Timer2 PWM in power-save)
+    #define AMBIENT_LED_ON()      BSP_LED1_ON()    // Chest - arc reactor
+    #define AMBIENT_LED_OFF()     BSP_LED1_OFF()
     
 #endif   // BOARD_IRONMAN_SUIT
 
@@ -1,18 +1,27 @@
 // ****************************************************************************
 // ADC
 // ****************************************************************************
-// ADC in 8 bit mode with internal reference voltage
+// ADC with internal reference voltage
+//
+// Internal reference differs from chip to chip (1.0..1.2V). It is calibrated
+// once per board against known AVcc and kept in EEPROM.
 //
 // To enable ADC, in external file must be defined:
 //    BSP_SYS_CLK_HZ
 //
 // ****************************************************************************
 #include <stdint.h> 
+#include <avr/eeprom.h>
+#include <util/delay.h>
 #include "bsp.h"
 #include "bsp_hal.h"
 #include "bsp_trace.h"
 #include "bsp_gpio.h"
 #include "bsp_adc.h"
+#include "bsp_power.h"
+#include "bsp_uart.h"
+#include "bsp_events.h"
+#include "bsp_time.h"
 
 
 // ADC channel which performed last measurement
@@ -24,6 +33,68 @@ static volatile uint8_t adc_raw8;
 // Lowest bit (noised) of 10 raw adc bits  
 static volatile uint8_t adc_raw_minor_bit;
 
+// Raw 10-bit ADC measurement
+static volatile uint16_t adc_raw10;
+
+// Reference voltage [mV] and its calibrated value (erased EEPROM: 0xFFFF)
+static uint16_t adc_ref_mv = BSP_ADC_REF_mV;
+static uint16_t adc_ref_eeprom EEMEM;
+
+// Measurement is finished (for waiting in noise reduction mode)
+static volatile uint8_t adc_is_done;
+
+// Oversampling: conversions of measurement (log2), conversions left, their sum
+static uint8_t           adc_os_log2;
+static volatile uint8_t  adc_os_left;
+static volatile uint16_t adc_os_sum;
+
+// 12-bit measurement
+static volatile uint16_t adc_raw12;
+
+#if ((BSP_ADC_OVERSAMPLE_64 > 6) || (BSP_ADC_OVERSAMPLE_16 < 2))
+    #error "ERROR: Sum of oversampled conversions must fit 16 bits and be decimated to 12 bits"
+#endif
+
+#ifdef ADC_SCAN_ENABLED
+#if ((BSP_ADC_SCAN_RING_SIZE & (BSP_ADC_SCAN_RING_SIZE - 1)) != 0) || (BSP_ADC_SCAN_RING_SIZE > 64)
+    #error "ERROR: BSP_ADC_SCAN_RING_SIZE must be power of 2, up to 64 (16-bit sum)"
+#endif
+#define ADC_SCAN_RING_MASK  (BSP_ADC_SCAN_RING_SIZE - 1)
+
+// Scan channel: ISR writes ring[seq & mask], then increments seq
+typedef struct {
+    uint8_t            channel;
+    uint8_t            is_filled;            // ring has the first result
+    volatile uint8_t   seq;
+    volatile uint16_t  ring[BSP_ADC_SCAN_RING_SIZE];
+} adc_scan_chan_t;
+
+static adc_scan_chan_t   adc_scan_chans[BSP_ADC_SCAN_MAX];
+static uint8_t           adc_scan_num;
+static volatile uint8_t  adc_scan_idx;       // channel of running conversion
+static volatile uint8_t  adc_scan_is_run;
+#endif
+
+// Prepare new measurement (ADC interrupt must be disabled or ADC must be idle)
+static void adc_measure_begin(void)
+{
+    adc_is_done = 0;
+    adc_os_sum = 0;
+    adc_os_left = (1 << adc_os_log2);
+}
+
+// ADC block is acquired
+static uint8_t adc_is_enabled;
+
+// Acquire ADC block before enabling
+static void adc_power_on(void)
+{
+    if (!adc_is_enabled) {
+        adc_is_enabled = 1;
+        BSP_power_acquire(BSP_POWER_ADC);
+    }
+}
+
 
 
 // ****************************************************************************
@@ -31,17 +102,29 @@ static volatile uint8_t adc_raw_minor_bit;
 // ****************************************************************************
 void BSP_adc_init (void) 
 {
-	// Init all pins, configure speed, reference etc.
+	// Init all pins, configure speed, reference etc. (ADC clock is needed to access registers)
+    BSP_power_acquire(BSP_POWER_ADC);
 	ADC_INIT();
+    BSP_power_release(BSP_POWER_ADC);
                  
     adc_raw8 = 0;
     adc_raw_minor_bit = 0;
+    adc_raw12 = 0;
+    adc_os_log2 = BSP_ADC_OVERSAMPLE_NONE;
+    
+    // Calibrated reference (nominal one if board is not calibrated)
+    adc_ref_mv = eeprom_read_word(&adc_ref_eeprom);
+    if ((adc_ref_mv < BSP_ADC_REF_MIN_mV) || (adc_ref_mv > BSP_ADC_REF_MAX_mV)) {
+        adc_ref_mv = BSP_ADC_REF_mV;
+    }
 }
 
 //-------------------------------------------------------------------------------
 // Configure ADC multiplexor with given ADC channel and enable ADC
 void BSP_adc_enable(uint8_t channel)  
 {
+    adc_power_on();
+    
     switch(channel) {
 #ifdef ADC0_ENABLED    
         case 0: ADC_ON(ADC_INPUT_0); break;
@@ -84,15 +167,67 @@ void BSP_adc_enable(uint8_t channel)
 
 //-------------------------------------------------------------------------------
 // Configure ADC multiplexor to measure temperature and enable ADC
-void BSP_adc_enable_temperature(void) { ADC_ON(ADC_INPUT_TEMP); }
+void BSP_adc_enable_temperature(void) { adc_power_on(); ADC_ON(ADC_INPUT_TEMP); }
 
 //-------------------------------------------------------------------------------
 // Disable ADC
-void BSP_adc_disable(void)            { ADC_OFF();    } 
+void BSP_adc_disable(void)
+{
+    if (adc_is_enabled) {
+        ADC_OFF();
+        adc_is_enabled = 0;
+        BSP_power_release(BSP_POWER_ADC);
+    }
+} 
+
+//-------------------------------------------------------------------------------
+// Conversions for next measurements
+void BSP_adc_oversample(uint8_t log2)
+{
+    BSP_ASSERT((log2 == BSP_ADC_OVERSAMPLE_NONE) || (log2 == BSP_ADC_OVERSAMPLE_16) || (log2 == BSP_ADC_OVERSAMPLE_64));
+    adc_os_log2 = log2;
+}
+
+//-------------------------------------------------------------------------------
+// Start measurement, the rest of conversions are started by ISR
+void BSP_adc_start(void)
+{
+    BSP_USE_CRITICAL();
+    BSP_CRITICAL(adc_measure_begin(); ADC_START());
+}
+
+//-------------------------------------------------------------------------------
+// Measurement is finished
+uint8_t BSP_adc_is_ready(void)        { return adc_is_done; }
+
+//-------------------------------------------------------------------------------
+// Measurement in ADC noise reduction mode: entering the mode starts conversion.
+// I/O clock is stopped in this mode: UART TX is flushed first, timers 0 and 1 
+// don't count during conversion. Other interrupts wake MCU up, it sleeps again.
+void BSP_adc_convert_sleep(void)
+{
+    BSP_uart_flush();
+    adc_measure_begin();
+    while (1) {
+        BSP_ALL_INT_DISABLE();
+        if (adc_is_done) {
+            break;
+        }
+        SLEEP_ADC_NOISE_REDUCTION_MODE_SEI();
+    }
+    BSP_ALL_INT_ENABLE();
+}
 
+#ifdef CLOCK_SCALING_ENABLED
 //-------------------------------------------------------------------------------
-// Start single measurement
-void BSP_adc_start(void)              { ADC_START();  }
+// Prescaler for new system clock (ADC clock is needed to access registers)
+void BSP_adc_clock_set(uint8_t ps)
+{
+    BSP_power_acquire(BSP_POWER_ADC);
+    ADC_SET_PRESCALLER_BITS(ps);
+    BSP_power_release(BSP_POWER_ADC);
+}
+#endif
 
 
 
@@ -124,18 +259,210 @@ uint8_t BSP_adc_get_last_raw8 (void)
 
 
 //-------------------------------------------------------------------------------
-// Convert raw 8-bit ADC measurement to decades of millivolts
-uint8_t BSP_adc_to_mV_x10 (uint8_t raw8) 
-{       
+// Get raw 10-bit ADC measurement
+uint16_t BSP_adc_get_last_raw10 (void)
+{
+    uint16_t tmp;  
+    BSP_USE_CRITICAL();
+    BSP_CRITICAL(tmp = adc_raw10);
+    return tmp;
+}
+
+
+//-------------------------------------------------------------------------------
+// Get 12-bit measurement
+uint16_t BSP_adc_get_last_raw12 (void)
+{
     uint16_t tmp;  
-    tmp = raw8;
-    tmp = ADC_RAW8_TO_mV_x10(tmp);
+    BSP_USE_CRITICAL();
+    BSP_CRITICAL(tmp = adc_raw12);
+    return tmp;
+}
+
+
+#ifdef ADC_SCAN_ENABLED
+//-------------------------------------------------------------------------------
+// Start scan of channels, results are cleared
+void BSP_adc_scan_start(const uint8_t * channels_p, uint8_t num)
+{
+    BSP_ASSERT((num != 0) && (num <= BSP_ADC_SCAN_MAX));
+
+    BSP_adc_scan_stop();
+    for (uint8_t i = 0; i < num; ++i) {
+        adc_scan_chans[i].channel = channels_p[i];
+        adc_scan_chans[i].seq = 0;
+        adc_scan_chans[i].is_filled = 0;
+        for (uint8_t j = 0; j < BSP_ADC_SCAN_RING_SIZE; ++j) {
+            adc_scan_chans[i].ring[j] = 0;
+        }
+    }
+    adc_scan_num = num;
+    adc_scan_idx = 0;
+    BSP_adc_scan_resume();
+}
+
+//-------------------------------------------------------------------------------
+// Stop scan: trigger is off, running conversion is finished (its result is stored)
+// Interrupts must be enabled: result of running conversion must not be left pending
+void BSP_adc_scan_stop(void)
+{
+    if (!adc_scan_is_run) {
+        return;
+    }
+    ADC_SCAN_TRIGGER_OFF();
+    while (ADC_IS_BUSY());
+    adc_scan_is_run = 0;
+    BSP_adc_disable();
+    BSP_time_release(BSP_TIME_USER_ADC);
+}
+
+//-------------------------------------------------------------------------------
+// Continue stopped scan from the next channel
+void BSP_adc_scan_resume(void)
+{
+    if (adc_scan_is_run || (adc_scan_num == 0)) {
+        return;
+    }
+    // Conversions are triggered by time base overflow
+    BSP_time_hold(BSP_TIME_USER_ADC);
+    adc_power_on();
+    ADC_ON(adc_scan_chans[adc_scan_idx].channel);
+    adc_scan_is_run = 1;
+    ADC_SCAN_TRIGGER_ON();
+}
+
+//-------------------------------------------------------------------------------
+uint8_t BSP_adc_scan_is_run(void)
+{
+    return adc_scan_is_run;
+}
+
+//-------------------------------------------------------------------------------
+// Sequence number of the last result
+uint8_t BSP_adc_scan_seq(uint8_t idx)
+{
+    return adc_scan_chans[idx].seq;
+}
+
+//-------------------------------------------------------------------------------
+// The last result: ring slot is read again if ISR has written new result meanwhile
+uint16_t BSP_adc_scan_latest(uint8_t idx, uint8_t * seq_p)
+{
+    adc_scan_chan_t * chan_p = &adc_scan_chans[idx];
+    uint8_t  seq;
+    uint16_t val;
+
+    do {
+        seq = chan_p->seq;
+        val = chan_p->ring[(uint8_t)(seq - 1) & ADC_SCAN_RING_MASK];
+    } while (seq != chan_p->seq);
+
+    if (seq_p) {
+        *seq_p = seq;
+    }
+    return val;
+}
+
+//-------------------------------------------------------------------------------
+// Average of ring as 12-bit value
+uint16_t BSP_adc_scan_average12(uint8_t idx)
+{
+    adc_scan_chan_t * chan_p = &adc_scan_chans[idx];
+    uint8_t  seq;
+    uint16_t sum;
+
+    do {
+        seq = chan_p->seq;
+        sum = 0;
+        for (uint8_t i = 0; i < BSP_ADC_SCAN_RING_SIZE; ++i) {
+            sum += chan_p->ring[i];
+        }
+    } while (seq != chan_p->seq);
+
+    return (uint16_t)(((uint32_t)sum * 4) / BSP_ADC_SCAN_RING_SIZE);
+}
+
+//-------------------------------------------------------------------------------
+// Scan result (ISR): store to ring of channel, switch multiplexor to the next channel
+// Conversion is finished long before the next frame - new input is settled
+static inline void adc_scan_put(uint16_t raw10)
+{
+    adc_scan_chan_t * chan_p = &adc_scan_chans[adc_scan_idx];
+    uint8_t seq = chan_p->seq;
+
+    if (!chan_p->is_filled) {
+        // The first result fills ring: average is valid at once
+        for (uint8_t i = 0; i < BSP_ADC_SCAN_RING_SIZE; ++i) {
+            chan_p->ring[i] = raw10;
+        }
+        chan_p->is_filled = 1;
+    }
+    else {
+        chan_p->ring[seq & ADC_SCAN_RING_MASK] = raw10;
+    }
+    chan_p->seq = seq + 1;
+
+    if (++adc_scan_idx >= adc_scan_num) {
+        adc_scan_idx = 0;
+    }
+    ADC_SET_INPUT(adc_scan_chans[adc_scan_idx].channel);
+}
+#endif  // ADC_SCAN_ENABLED
+
+
+//-------------------------------------------------------------------------------
+// Reference voltage [mV]
+uint16_t BSP_adc_ref_mv(void)
+{
+    return adc_ref_mv;
+}
+
+//-------------------------------------------------------------------------------
+// Calibrate internal reference against known AVcc: 
+//   bandgap = AVcc * raw12 / 4096
+// Bandgap is the internal reference itself. Division is by 2^12 here too.
+uint16_t BSP_adc_calibrate(uint16_t vcc_mv)
+{
+    uint16_t raw12;
+    uint16_t ref_mv;
+#ifdef ADC_SCAN_ENABLED
+    uint8_t is_scan = BSP_adc_scan_is_run();
+    BSP_adc_scan_stop();
+#endif
+
+    adc_power_on();
+    ADC_REF_AVCC();
+    ADC_ON(ADC_INPUT_BANDGAP);
+    _delay_ms(BSP_ADC_REF_SETTLE_MS);
+    BSP_adc_oversample(BSP_ADC_OVERSAMPLE_NONE);
+    BSP_adc_convert_sleep();    // the first conversion after switch is dropped
+    BSP_adc_oversample(BSP_ADC_OVERSAMPLE_64);
+    BSP_adc_convert_sleep();
+    raw12 = BSP_adc_get_last_raw12();
+    BSP_adc_oversample(BSP_ADC_OVERSAMPLE_NONE);
+    ADC_REF_INTERNAL();
+    BSP_adc_disable();
+
+    ref_mv = ADC_RAW_TO_mV(raw12, vcc_mv, 12);
 
 #ifdef ADC_DEBUG 
-    BSP_TRACE("ADC%d raw 0x%02X -> %d mV_x10", adc_chan, raw8, tmp);  
+    BSP_TRACE("ADC bandgap raw12 %u at AVcc %u mV -> %u mV", raw12, vcc_mv, ref_mv);  
 #endif
 
-    return (uint8_t)tmp; 
+    if ((ref_mv < BSP_ADC_REF_MIN_mV) || (ref_mv > BSP_ADC_REF_MAX_mV)) {
+        ref_mv = 0;
+    }
+    else {
+        adc_ref_mv = ref_mv;
+        eeprom_update_word(&adc_ref_eeprom, ref_mv);
+    }
+
+#ifdef ADC_SCAN_ENABLED
+    if (is_scan) {
+        BSP_adc_scan_resume();
+    }
+#endif
+    return ref_mv;
 }
 
 
@@ -143,5 +470,32 @@ uint8_t BSP_adc_to_mV_x10 (uint8_t raw8)
 //-------------------------------------------------------------------------------
 //interrupt  [ADC_INT] void BSP_adcint_isr(void) 
 ISR (ADC_vect) { 
-    ADC_RAW8_GET_VALUES(adc_raw8, adc_raw_minor_bit);
+    uint16_t raw10;
+    uint8_t  raw8;
+    
+    ADC_RAW10_GET_VALUES(raw10, raw8);
+    adc_raw10 = raw10;
+    adc_raw8 = raw8;
+    adc_raw_minor_bit = raw10 & 0x01;
+    
+#ifdef ADC_SCAN_ENABLED
+    if (adc_scan_is_run) {
+        adc_scan_put(raw10);
+        return;
+    }
+#endif
+    
+    // Oversampling: sum conversions, the next one is started at once
+    adc_os_sum += raw10;
+    if (adc_os_left > 1) {
+        adc_os_left--;
+        ADC_START();
+        return;
+    }
+    adc_os_left = 0;
+    
+    // Decimation: log2 - 2 bits are averaged, 2 bits are added (10 -> 12 bits)
+    adc_raw12 = (adc_os_log2 >= 2) ? (adc_os_sum >> (adc_os_log2 - 2)) : (adc_os_sum << 2);
+    adc_is_done = 1;
+    BSP_EVENT_SET_ISR(BSP_EVENT_ADC);
 }    
\ No newline at end of file
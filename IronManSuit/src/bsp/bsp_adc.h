@@ -1,5 +1,5 @@
 // ****************************************************************************
-// ADC in 8 bit mode with internal reference voltage
+// ADC with internal reference voltage (calibrated per board)
 // ****************************************************************************
 //
 // To enable ADC, in external file must be defined:
@@ -26,6 +26,51 @@
 //#define ADC_DEBUG   // debug output for all ADC measurements
 
 
+// ****************************************************************************
+// Oversampling
+// ****************************************************************************
+// Measurement can be a set of 16 or 64 conversions: ISR sums them and starts
+// the next one, the sum is decimated to 12 bits. 16 conversions give 2 extra
+// bits, 64 conversions - 3 bits (one more bit of averaging). ADC noise must be
+// at least 1 LSB for extra bits (internal noise is usually enough).
+// BSP_EVENT_ADC is set when measurement is finished.
+#define BSP_ADC_OVERSAMPLE_NONE     0       // single conversion (log2 of conversions)
+#define BSP_ADC_OVERSAMPLE_16       4
+#define BSP_ADC_OVERSAMPLE_64       6
+
+
+// ****************************************************************************
+// Scan
+// ****************************************************************************
+// To enable scan, in external file must be defined:
+//    ADC_SCAN_ENABLED
+//    TIMEBASE_ENABLED
+//
+// Channels from the list are measured in turn, one conversion per time base
+// frame (Timer 1 overflow triggers conversion, ISR switches multiplexor to the
+// next channel). Main loop is not involved at all. Each channel has its own ring
+// of the last results and sequence number of the last result: ISR writes result,
+// then increments sequence number, so readers don't disable interrupts - they 
+// repeat reading if sequence number is changed meanwhile.
+// Single measurements are not allowed while scan runs (stop scan, then resume it).
+#ifdef ADC_SCAN_ENABLED
+
+#ifndef TIMEBASE_ENABLED
+    #error "ERROR: TIMEBASE_ENABLED must be defined for ADC scan trigger"
+#endif
+
+#define BSP_ADC_SCAN_MAX            4       // channels in list
+#define BSP_ADC_SCAN_RING_SIZE      4       // results of each channel (power of 2)
+
+#endif  // ADC_SCAN_ENABLED
+
+// Channel of internal temperature sensor (for scan list)
+#define BSP_ADC_CHANNEL_TEMP        8
+
+// AREF capacitor is recharged after ADC enable or reference switch [ms]
+#define BSP_ADC_REF_SETTLE_MS       5
+
+
 // ****************************************************************************
 // ADC init and control
 // ****************************************************************************
@@ -33,12 +78,53 @@ void BSP_adc_init(void);                   // Init pins, speed, reference
 void BSP_adc_enable(uint8_t channel);      // Configure ADC multiplexor with given ADC channel and enable ADC
 void BSP_adc_enable_temperature(void);     // Configure ADC multiplexor to measure temperature and enable ADC
 void BSP_adc_disable(void);                // Disable ADC
-void BSP_adc_start(void);                  // Start single measurement
+void BSP_adc_oversample(uint8_t log2);     // Conversions for next measurements (BSP_ADC_OVERSAMPLE_xxx)
+void BSP_adc_start(void);                  // Start measurement (single or oversampled)
+void BSP_adc_convert_sleep(void);          // Measurement in noise reduction mode, returns when it is finished
+uint8_t BSP_adc_is_ready(void);            // Measurement is finished
+void BSP_adc_clock_set(uint8_t ps);        // Prescaler for new system clock (CLOCK_SCALING_ENABLED)
 
 // Get last measurement
 uint8_t BSP_adc_get_last_minor_bit(void);  // Minor bit (most noised) from 10-bit ADC measurement (0b0000000X)
 uint8_t BSP_adc_get_last_raw8(void);       // Raw 8-bit ADC measurement (high 8 bits of 10 raw adc bits)
-uint8_t BSP_adc_to_mV_x10 (uint8_t raw8);  // Convert raw 8-bit ADC measurement to decades of millivolts
+uint16_t BSP_adc_get_last_raw10(void);     // Raw 10-bit ADC measurement (the last conversion)
+uint16_t BSP_adc_get_last_raw12(void);     // 12-bit measurement (decimated sum, or single conversion << 2)
+
+// Reference voltage [mV]: calibrated value from EEPROM (nominal one if board is not calibrated)
+uint16_t BSP_adc_ref_mv(void);
+
+// Convert measurement of <bits> width (raw8 - 8, raw10 - 10, raw12 - 12, up to 16) to millivolts.
+// No division: mV = raw * ref_mV >> bits
+#define BSP_adc_to_mv(raw, bits)    ADC_RAW_TO_mV((raw), BSP_adc_ref_mv(), (bits))
+
+// Calibrate internal reference: board is powered from known AVcc <vcc_mv>, bandgap 
+// is measured against it. Calibrated reference is saved to EEPROM.
+// Returns reference [mV], or 0 if it is out of range (wrong AVcc) and is not saved.
+uint16_t BSP_adc_calibrate(uint16_t vcc_mv);
+
+
+#ifdef ADC_SCAN_ENABLED
+// Start scan of channels (ADCn number or BSP_ADC_CHANNEL_TEMP), results are cleared
+void BSP_adc_scan_start(const uint8_t * channels_p, uint8_t num);
+
+// Stop scan, running conversion is finished first
+void BSP_adc_scan_stop(void);
+
+// Continue stopped scan, results are kept
+void BSP_adc_scan_resume(void);
+
+uint8_t BSP_adc_scan_is_run(void);
+
+// Sequence number of the last result of channel <idx> in list (counts results, wraps at 256)
+uint8_t BSP_adc_scan_seq(uint8_t idx);
+
+// The last 10-bit result of channel <idx> in list, its sequence number is saved to seq_p (if not NULL)
+uint16_t BSP_adc_scan_latest(uint8_t idx, uint8_t * seq_p);
+
+// Average of ring of channel <idx> in list as 12-bit value
+// (ring is filled by the first result, so average is valid after it)
+uint16_t BSP_adc_scan_average12(uint8_t idx);
+#endif
 
 
 
@@ -0,0 +1,111 @@
+// ****************************************************************************
+// Battery voltage monitor
+// ****************************************************************************
+//
+// Divider powered by LED5 pin, ADC5 in noise reduction mode, IIR filter
+//
+// ****************************************************************************
+#include <stdint.h>
+#include <util/delay.h>
+#include "bsp.h"
+#include "bsp_hal.h"
+#include "bsp_gpio.h"
+#include "bsp_adc.h"
+#include "bsp_time.h"
+#include "bsp_battery.h"
+
+
+#ifdef BATTERY_ENABLED
+
+// Filter state: 12-bit value scaled by 2^BSP_BATTERY_FILTER_SHIFT
+static uint16_t battery_filter;
+static uint8_t  battery_is_measured;
+
+#if ((4095UL << BSP_BATTERY_FILTER_SHIFT) > 0xFFFF)
+    #error "ERROR: BSP_BATTERY_FILTER_SHIFT is too big for 16-bit filter"
+#endif
+
+// Filter state to battery voltage [mV]: fractional bits of filter are kept, no division
+#define BATTERY_FILTER_TO_MV(filter) (BSP_adc_to_mv((filter), 12 + BSP_BATTERY_FILTER_SHIFT) * BSP_BATTERY_DIVIDER)
+
+
+
+//-------------------------------------------------------------------------------
+// Init ADC and divider enable pin
+void BSP_battery_init(void)
+{
+    BSP_adc_init();
+    BSP_LED5_OFF();
+    battery_is_measured = 0;
+}
+
+//-------------------------------------------------------------------------------
+// One measurement. Noise reduction mode stops Timer1: while servo pulses are
+// generated, MCU waits in IDLE mode (timers run, conversion is a bit noisier).
+static void battery_convert(void)
+{
+#ifdef TIMEBASE_ENABLED
+    if (bsp_time_users & BSP_TIME_USER_SERVO) {
+        BSP_adc_start();
+        BSP_ALL_INT_DISABLE();
+        while (!BSP_adc_is_ready()) {
+            SLEEP_IDLE_MODE_SEI();
+            BSP_ALL_INT_DISABLE();
+        }
+        BSP_ALL_INT_ENABLE();
+        return;
+    }
+#endif
+    BSP_adc_convert_sleep();
+}
+
+//-------------------------------------------------------------------------------
+// Measure battery voltage, update filter
+uint16_t BSP_battery_measure(void)
+{
+    uint16_t raw12;
+#ifdef ADC_SCAN_ENABLED
+    // ADC is taken from scan for a while
+    uint8_t is_scan = BSP_adc_scan_is_run();
+    BSP_adc_scan_stop();
+#endif
+
+    // Divider settles much faster than reference
+    BSP_LED5_ON();
+    BSP_adc_enable(BSP_BATTERY_ADC_CHANNEL);
+    _delay_ms(BSP_ADC_REF_SETTLE_MS);
+    BSP_adc_oversample(BSP_ADC_OVERSAMPLE_NONE);
+    battery_convert();          // the first conversion after enable is dropped
+    BSP_adc_oversample(BSP_BATTERY_OVERSAMPLE);
+    battery_convert();
+    raw12 = BSP_adc_get_last_raw12();
+    BSP_adc_oversample(BSP_ADC_OVERSAMPLE_NONE);
+    BSP_adc_disable();
+    BSP_LED5_OFF();
+#ifdef ADC_SCAN_ENABLED
+    if (is_scan) {
+        BSP_adc_scan_resume();
+    }
+#endif
+
+    if (battery_is_measured) {
+        battery_filter += raw12 - (battery_filter >> BSP_BATTERY_FILTER_SHIFT);
+    }
+    else {
+        battery_filter = raw12 << BSP_BATTERY_FILTER_SHIFT;
+        battery_is_measured = 1;
+    }
+    return BSP_battery_mv();
+}
+
+//-------------------------------------------------------------------------------
+// Filtered voltage of the last measurement
+uint16_t BSP_battery_mv(void)
+{
+    if (!battery_is_measured) {
+        return 0;
+    }
+    return BATTERY_FILTER_TO_MV(battery_filter);
+}
+
+#endif  // BATTERY_ENABLED
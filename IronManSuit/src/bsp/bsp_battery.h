@@ -0,0 +1,59 @@
+// ****************************************************************************
+// Battery voltage monitor
+// ****************************************************************************
+//
+// To enable monitor, in external file must be defined:
+//    BATTERY_ENABLED
+//    ADC5_ENABLED
+//
+// Battery voltage divider is powered by LED5 pin only for measurement, so it
+// does not drain battery between measurements. Each measurement:
+//
+//    divider and ADC on -> reference settle -> ADC5 in noise reduction mode ->
+//    -> divider and ADC off
+//
+// Internal reference is settled for BSP_ADC_REF_SETTLE_MS (AREF capacitor), the first
+// conversion after ADC enable is dropped, then 16 conversions are oversampled to 12 bits
+// (about 1 mV per bit). While servo pulses are generated, conversions are waited in IDLE
+// mode: noise reduction mode would stop Timer1 and stretch pulses.
+// Voltage is smoothed by fixed-point IIR filter: y += (x - y) / 2^shift.
+//
+// ****************************************************************************
+#ifndef BSP_BATTERY_H
+#define BSP_BATTERY_H
+
+#include <stdint.h>
+#include "bsp.h"
+
+
+#ifdef BATTERY_ENABLED
+
+#ifndef ADC5_ENABLED
+    #error "ERROR: ADC5_ENABLED must be defined for battery voltage"
+#endif
+
+// Monitor settings
+#define BSP_BATTERY_ADC_CHANNEL     5
+#define BSP_BATTERY_DIVIDER         4       // battery voltage / ADC pin voltage
+#define BSP_BATTERY_FILTER_SHIFT    2       // IIR filter: new measurement has weight 1/4
+#define BSP_BATTERY_OVERSAMPLE      BSP_ADC_OVERSAMPLE_16
+
+
+// ****************************************************************************
+// Monitor control
+// ****************************************************************************
+// Init ADC and divider enable pin (divider is off)
+void BSP_battery_init(void);
+
+// Measure battery voltage, update filter. Blocking: 5 ms settle and about 1.8 ms of
+// conversions (17 conversions of 104 us at 125 kHz ADC clock).
+// Returns filtered voltage [mV].
+uint16_t BSP_battery_measure(void);
+
+// Filtered voltage of the last measurement [mV], 0 - not measured yet
+uint16_t BSP_battery_mv(void);
+
+#endif  // BATTERY_ENABLED
+
+
+#endif  // BSP_BATTERY_H
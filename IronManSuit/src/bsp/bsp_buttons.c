@@ -0,0 +1,159 @@
+// ****************************************************************************
+// Buttons debouncer
+// ****************************************************************************
+//
+// Vertical counters debouncer for all buttons at once, samples are read
+// from the port or taken from captured port values
+//
+// ****************************************************************************
+#include <stdint.h>
+#include "bsp.h"
+#include "bsp_hal.h"
+#include "bsp_gpio.h"
+#include "bsp_buttons.h"
+
+
+// ----------------------------------------------------------------------------
+// Debouncer state (bit n - BTNn)
+static uint8_t btns_state;    // debounced state
+static uint8_t btns_cnt0;     // vertical counter, low bit
+static uint8_t btns_cnt1;     // vertical counter, high bit
+
+// Captured port value (bit n - BTNn is pressed), time of its next sample
+// and the last edge of each button
+static uint8_t  btns_sample;
+static uint32_t btns_sample_us;
+static uint32_t btns_edge_us[5];   // BTN0..BTN4
+
+
+
+// ----------------------------------------------------------------------------
+// One debouncer step for all buttons, toggled buttons are returned
+static uint8_t buttons_step(uint8_t sample)
+{
+    uint8_t delta;
+    uint8_t toggle;
+
+    // Counter is reset for buttons equal to debounced state,
+    // for the others it counts 0-1-2-3-0 and state toggles at overflow
+    delta = sample ^ btns_state;
+    btns_cnt1 = (btns_cnt1 ^ btns_cnt0) & delta;
+    btns_cnt0 = (~btns_cnt0) & delta;
+    toggle = delta & (~(btns_cnt0 | btns_cnt1));
+    btns_state ^= toggle;
+
+    return toggle;
+}
+
+
+// ----------------------------------------------------------------------------
+// Reset debouncer (all buttons are released)
+void BSP_buttons_init(void)
+{
+    btns_state = 0;
+    btns_cnt0 = 0;
+    btns_cnt1 = 0;
+    btns_sample = 0;
+}
+
+
+// ----------------------------------------------------------------------------
+// Read port, debounce all buttons and get edges
+uint8_t BSP_buttons_scan(bspButtons_t * btns_p)
+{
+#if (BTNS_NUM > 0)
+    uint8_t port = BTNS_PIN;                        // the only port read
+    uint8_t sample = BSP_BTNS_TO_MASK(port);
+#else
+    uint8_t sample = 0;
+#endif
+    uint8_t toggle = buttons_step(sample);
+
+    btns_p->state = btns_state;
+    btns_p->pressed = toggle & btns_state;
+    btns_p->released = toggle & (~btns_state);
+
+    return (btns_state | sample);
+}
+
+
+// ----------------------------------------------------------------------------
+// Store captured port value
+// Counters of buttons which are back to their state are reset at once: 
+// samples of the next bounce are counted from zero
+void BSP_buttons_capture(uint8_t port, uint32_t time_us)
+{
+    uint8_t sample = BSP_BTNS_TO_MASK(port);
+    uint8_t changed = sample ^ btns_sample;
+    uint8_t delta = sample ^ btns_state;
+
+    // Idle debouncer: samples are taken in phase with this edge
+    if (btns_sample == btns_state) {
+        btns_sample_us = time_us + BSP_BUTTONS_SAMPLE_US;
+    }
+    for (uint8_t i = 0; changed; ++i, changed >>= 1) {
+        if (changed & 1) {
+            btns_edge_us[i] = time_us;
+        }
+    }
+    btns_sample = sample;
+    btns_cnt0 &= delta;
+    btns_cnt1 &= delta;
+}
+
+
+// ----------------------------------------------------------------------------
+// Take samples up to <now_us>
+// Each button toggles at most once: its sample is the same until the next capture
+uint8_t BSP_buttons_sample(uint32_t now_us, bspButtons_t * btns_p)
+{
+    uint8_t toggle = 0;
+
+    while ((btns_sample != btns_state) && ((int32_t)(now_us - btns_sample_us) >= 0)) {
+        toggle |= buttons_step(btns_sample);
+        btns_sample_us += BSP_BUTTONS_SAMPLE_US;
+    }
+
+    btns_p->state = btns_state;
+    btns_p->pressed = toggle & btns_state;
+    btns_p->released = toggle & (~btns_state);
+
+    return (btns_sample ^ btns_state);
+}
+
+
+// ----------------------------------------------------------------------------
+// Time until the last toggle: the lowest counter among differing buttons
+// needs the most samples (counter value k - 4-k samples are left)
+uint32_t BSP_buttons_next_us(uint32_t now_us)
+{
+    uint8_t delta = btns_sample ^ btns_state;
+    uint8_t left;
+    int32_t left_us;
+
+    if (!delta) {
+        return 0;
+    }
+    if (delta & ~(btns_cnt0 | btns_cnt1)) {
+        left = 4;
+    }
+    else if (delta & btns_cnt0 & ~btns_cnt1) {
+        left = 3;
+    }
+    else if (delta & btns_cnt1 & ~btns_cnt0) {
+        left = 2;
+    }
+    else {
+        left = 1;
+    }
+    left_us = (int32_t)(btns_sample_us + (left - 1) * BSP_BUTTONS_SAMPLE_US - now_us);
+
+    return (left_us > 0) ? (uint32_t)left_us : 1;
+}
+
+
+// ----------------------------------------------------------------------------
+uint32_t BSP_buttons_edge_us(uint8_t n)
+{
+    return btns_edge_us[n];
+}
@@ -0,0 +1,140 @@
+// ****************************************************************************
+// Buttons debouncer
+// ****************************************************************************
+//
+// All buttons must be connected to one port. It must be defined in external file:
+//    BTNS_PIN               - PIN register of all BTNn
+//
+// Port is read once per scan, all buttons are debounced at once by vertical
+// counters: bit n of each counter byte belongs to BTNn, so one scan is a few
+// bitwise operations for any number of buttons. Button state is changed after
+// BSP_BUTTONS_SAMPLES equal samples in a row.
+//
+// If port value is captured by pin change interrupt, the same counters run over
+// captured values: BSP_buttons_capture() stores port value and the moment of its
+// edge, BSP_buttons_sample() takes samples of stored value every
+// BSP_BUTTONS_SAMPLE_US up to given time (the port is not read at all). Samples
+// are taken only while some button differs from its state, so at most
+// BSP_BUTTONS_SAMPLES steps are done after the last edge. Press and release
+// moments are timestamps of the last edges, not the moments of samples.
+//
+// All masks are in button numbers order (bit n - BTNn), not in port bits order.
+//
+// ****************************************************************************
+#ifndef BSP_BUTTONS_H
+#define BSP_BUTTONS_H
+
+#include <stdint.h>
+#include "bsp.h"
+#include "bsp_gpio.h"
+
+
+// Number of equal samples to change button state (2-bit vertical counter)
+#define BSP_BUTTONS_SAMPLES   4
+
+// Sample period of captured port value [us]
+#define BSP_BUTTONS_SAMPLE_US 2000UL
+
+#define BSP_BTN_MASK(n)       (1<<(n))
+
+
+#if (BTNS_NUM > 0) && (!defined BTNS_PIN)
+    #error "ERROR: BTNS_PIN must be defined (all buttons must be connected to one port)"
+#endif
+
+
+// ----------------------------------------------------------------------------
+// Port bits of buttons, port bit of BTNn to bit n, port value inversion for active low buttons
+#ifdef __BTN0_IS_DEFINED
+    #define _BTN0_TO_MASK(port)   ((((port) >> BTN0_BIT) & 0x01) << 0)
+    #define _BTN0_PORT_MASK       (1<<BTN0_BIT)
+    #define _BTN0_LOW_MASK        ((BTN0_IS_PRESSED_LOW) ? (1<<BTN0_BIT) : 0)
+#else
+    #define _BTN0_TO_MASK(port)   0
+    #define _BTN0_PORT_MASK       0
+    #define _BTN0_LOW_MASK        0
+#endif
+#ifdef __BTN1_IS_DEFINED
+    #define _BTN1_TO_MASK(port)   ((((port) >> BTN1_BIT) & 0x01) << 1)
+    #define _BTN1_PORT_MASK       (1<<BTN1_BIT)
+    #define _BTN1_LOW_MASK        ((BTN1_IS_PRESSED_LOW) ? (1<<BTN1_BIT) : 0)
+#else
+    #define _BTN1_TO_MASK(port)   0
+    #define _BTN1_PORT_MASK       0
+    #define _BTN1_LOW_MASK        0
+#endif
+#ifdef __BTN2_IS_DEFINED
+    #define _BTN2_TO_MASK(port)   ((((port) >> BTN2_BIT) & 0x01) << 2)
+    #define _BTN2_PORT_MASK       (1<<BTN2_BIT)
+    #define _BTN2_LOW_MASK        ((BTN2_IS_PRESSED_LOW) ? (1<<BTN2_BIT) : 0)
+#else
+    #define _BTN2_TO_MASK(port)   0
+    #define _BTN2_PORT_MASK       0
+    #define _BTN2_LOW_MASK        0
+#endif
+#ifdef __BTN3_IS_DEFINED
+    #define _BTN3_TO_MASK(port)   ((((port) >> BTN3_BIT) & 0x01) << 3)
+    #define _BTN3_PORT_MASK       (1<<BTN3_BIT)
+    #define _BTN3_LOW_MASK        ((BTN3_IS_PRESSED_LOW) ? (1<<BTN3_BIT) : 0)
+#else
+    #define _BTN3_TO_MASK(port)   0
+    #define _BTN3_PORT_MASK       0
+    #define _BTN3_LOW_MASK        0
+#endif
+#ifdef __BTN4_IS_DEFINED
+    #define _BTN4_TO_MASK(port)   ((((port) >> BTN4_BIT) & 0x01) << 4)
+    #define _BTN4_PORT_MASK       (1<<BTN4_BIT)
+    #define _BTN4_LOW_MASK        ((BTN4_IS_PRESSED_LOW) ? (1<<BTN4_BIT) : 0)
+#else
+    #define _BTN4_TO_MASK(port)   0
+    #define _BTN4_PORT_MASK       0
+    #define _BTN4_LOW_MASK        0
+#endif
+
+#define BSP_BTNS_LOW_MASK   (_BTN0_LOW_MASK | _BTN1_LOW_MASK | _BTN2_LOW_MASK | _BTN3_LOW_MASK | _BTN4_LOW_MASK)
+#define BSP_BTNS_PORT_MASK  (_BTN0_PORT_MASK | _BTN1_PORT_MASK | _BTN2_PORT_MASK | _BTN3_PORT_MASK | _BTN4_PORT_MASK)
+
+// Port value to buttons mask (bit n - BTNn is pressed)
+// Argument is used several times - it must be a variable, not a port register
+#define BSP_BTNS_TO_MASK(port)  (__BTNS_TO_MASK((uint8_t)((port) ^ BSP_BTNS_LOW_MASK)))
+#define __BTNS_TO_MASK(port)    (_BTN0_TO_MASK(port) | _BTN1_TO_MASK(port) | _BTN2_TO_MASK(port) | \
+                                 _BTN3_TO_MASK(port) | _BTN4_TO_MASK(port))
+
+
+// ****************************************************************************
+// Result of one scan
+// ****************************************************************************
+typedef struct {
+    uint8_t  state;      // debounced state (bit n - BTNn is pressed)
+    uint8_t  pressed;    // BTNn became pressed at this scan
+    uint8_t  released;   // BTNn became released at this scan
+} bspButtons_t;
+
+
+// ****************************************************************************
+// Buttons control
+// ****************************************************************************
+// Reset debouncer (all buttons are released)
+void BSP_buttons_init(void);
+
+// Read port, debounce all buttons and get edges
+// Returns 0 if debouncer is idle (all buttons are released and stable),
+// otherwise scan must be repeated
+uint8_t BSP_buttons_scan(bspButtons_t * btns_p);
+
+// Store port value captured at <time_us>. Samples before this moment must be
+// taken first (BSP_buttons_sample) and their edges processed.
+void BSP_buttons_capture(uint8_t port, uint32_t time_us);
+
+// Take samples of captured port value up to <now_us>, debounce them and get edges
+// Returns 0 if debouncer is idle (all buttons are equal to captured value)
+uint8_t BSP_buttons_sample(uint32_t now_us, bspButtons_t * btns_p);
+
+// Time left until debouncer is idle if no more edges are captured [us], 0 - it is idle
+uint32_t BSP_buttons_next_us(uint32_t now_us);
+
+// Time of the last captured edge of BTNn [us]: moment of press or release
+uint32_t BSP_buttons_edge_us(uint8_t n);
+
+
+#endif  // BSP_BUTTONS_H
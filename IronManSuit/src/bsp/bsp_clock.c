@@ -0,0 +1,81 @@
+// ****************************************************************************
+// System clock scaling
+// ****************************************************************************
+//
+// Settings of each clock are taken from flash table (hal_clock.h)
+//
+// ****************************************************************************
+#include <stdint.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+#include "bsp.h"
+#include "bsp_hal.h"
+#include "bsp_trace.h"
+#include "bsp_time.h"
+#include "bsp_timers.h"
+#include "bsp_uart.h"
+#include "bsp_adc.h"
+#include "bsp_clock.h"
+
+
+#ifdef CLOCK_SCALING_ENABLED
+
+// Settings for one system clock
+typedef struct {
+    uint8_t   clkps;              // system clock prescaller
+    uint8_t   time_cs;            // time base clock select
+    uint8_t   time_shift;         // time base count is (1 << shift) us
+    uint8_t   timer_cs;           // software timers hw-timer clock select
+    uint16_t  timer_count_us;     // hw-timer count [us]
+    uint8_t   timer_comparator;   // hw-timer 10ms period (not tickless)
+    uint16_t  uart_ubrr;          // double speed mode
+    uint8_t   adc_ps;             // ADC prescaller bits
+} clock_settings_t;
+
+static const clock_settings_t clock_settings[BSP_CLOCKS_NUM] PROGMEM = CLOCK_SETTINGS;
+
+static uint8_t clock_current = CLOCK_RESET_INDEX;
+
+
+
+//-------------------------------------------------------------------------------
+// Switch system clock and retune all blocks clocked by it
+void BSP_clock_set(bspClock_t clock)
+{
+    clock_settings_t settings;
+    BSP_USE_CRITICAL();
+
+    BSP_ASSERT(clock < BSP_CLOCKS_NUM);
+
+    if (clock == clock_current) {
+        return;
+    }
+    memcpy_P(&settings, &clock_settings[clock], sizeof(settings));
+
+    // Byte in UART shift register would be broken by new baud rate
+    if (BSP_uart_tx_is_busy()) {
+        BSP_uart_flush();
+    }
+
+    // Software timers are credited at old clock, all blocks are retuned right after change
+    BSP_CRITICAL_BEGIN();
+    BSP_timer_clock_suspend();
+    CLOCK_SET_PRESCALLER(settings.clkps);
+#ifdef TIMEBASE_ENABLED
+    BSP_time_clock_set(settings.time_cs, settings.time_shift);
+#endif
+    BSP_timer_clock_resume(settings.timer_cs, settings.timer_count_us, settings.timer_comparator);
+    BSP_uart_clock_set(settings.uart_ubrr);
+    BSP_adc_clock_set(settings.adc_ps);
+    clock_current = clock;
+    BSP_CRITICAL_END();
+}
+
+//-------------------------------------------------------------------------------
+// Current system clock
+bspClock_t BSP_clock_get(void)
+{
+    return (bspClock_t)clock_current;
+}
+
+#endif  // CLOCK_SCALING_ENABLED
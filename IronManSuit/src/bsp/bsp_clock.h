@@ -0,0 +1,49 @@
+// ****************************************************************************
+// System clock scaling
+// ****************************************************************************
+//
+// To enable clock scaling, in external file must be defined:
+//    CLOCK_SCALING_ENABLED
+//
+// System clock prescaller is changed at runtime. All blocks clocked by system
+// clock are retuned at once, in one critical section: software timers and
+// time base keep counting milliseconds and microseconds, servo pulses keep
+// their width, UART keeps its baud rate, ADC keeps its clock.
+//
+// Busy-wait delays (_delay_ms, _delay_us) are compiled for BSP_SYS_CLK_HZ,
+// so code with delays must run at BSP_CLOCK_NORMAL. Slow clock makes interrupt
+// latency longer (and time base resolution is 4us).
+//
+// ****************************************************************************
+#ifndef BSP_CLOCK_H
+#define BSP_CLOCK_H
+
+#include <stdint.h>
+#include "bsp.h"
+
+
+#ifdef CLOCK_SCALING_ENABLED
+
+// ****************************************************************************
+// System clocks
+// ****************************************************************************
+typedef enum {
+    BSP_CLOCK_SLOW,         // 250 kHz - waiting for events
+    BSP_CLOCK_NORMAL,       // BSP_SYS_CLK_HZ (1 MHz) - clock after reset
+    BSP_CLOCKS_NUM
+} bspClock_t;
+
+
+// ****************************************************************************
+// Clock control
+// ****************************************************************************
+// Switch system clock, UART TX is flushed first. Nothing is done for current clock.
+void BSP_clock_set(bspClock_t clock);
+
+// Current system clock
+bspClock_t BSP_clock_get(void);
+
+#endif  // CLOCK_SCALING_ENABLED
+
+
+#endif  // BSP_CLOCK_H
@@ -0,0 +1,48 @@
+// ****************************************************************************
+// Pending events
+// ****************************************************************************
+//
+// Bitmap of pending work for the main loop
+//
+// ****************************************************************************
+#include <stdint.h>
+#include "bsp.h"
+#include "bsp_hal.h"
+#include "bsp_events.h"
+
+
+// Pending events bitmap
+volatile uint8_t bsp_events;
+
+
+//-------------------------------------------------------------------------------
+// Set event bits from main loop
+void BSP_event_set(uint8_t mask)
+{
+    BSP_USE_CRITICAL();
+    BSP_CRITICAL(bsp_events |= mask);
+}
+
+//-------------------------------------------------------------------------------
+// Get all pending events and clear them
+uint8_t BSP_event_take(void)
+{
+    uint8_t events;
+    BSP_USE_CRITICAL();
+    BSP_CRITICAL(events = bsp_events; bsp_events = 0;);
+    return events;
+}
+
+//-------------------------------------------------------------------------------
+// Sleep in IDLE mode if there are no pending events
+// Interrupts are disabled for the check, SLEEP_IDLE_MODE_SEI() enables them
+// just before SLEEP instruction, so wake-up interrupt can't be missed.
+void BSP_event_wait(void)
+{
+    BSP_ALL_INT_DISABLE();
+    if (bsp_events) {
+        BSP_ALL_INT_ENABLE();
+        return;
+    }
+    SLEEP_IDLE_MODE_SEI();
+}
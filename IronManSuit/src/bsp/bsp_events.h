@@ -0,0 +1,51 @@
+// ****************************************************************************
+// Pending events
+// ****************************************************************************
+//
+// Bitmap of pending work for the main loop. Interrupts set bits, main loop
+// takes all bits at once, processes them and sleeps in IDLE mode while the
+// bitmap is empty.
+//
+// ****************************************************************************
+#ifndef BSP_EVENTS_H
+#define BSP_EVENTS_H
+
+#include <stdint.h>
+#include "bsp.h"
+
+
+// ****************************************************************************
+// Event bits
+// ****************************************************************************
+#define BSP_EVENT_SWTIMER       (1<<0)  // software timer is fired (handler must be called from main loop)
+#define BSP_EVENT_SLEEP_TIMER   (1<<1)  // sleep timer is fired (handler must be called from main loop)
+#define BSP_EVENT_EXTINT        (1<<2)  // external interrupt
+#define BSP_EVENT_PCINT         (1<<3)  // pin change is captured
+#define BSP_EVENT_RFRX          BSP_EVENT_EXTINT  // RF code is received (decoder owns INT0 pin)
+#define BSP_EVENT_RCIN          BSP_EVENT_PCINT   // RC channel pulse is measured (capture owns PCINT1)
+#define BSP_EVENT_ADC           (1<<4)  // ADC measurement is finished (single or oversampled)
+#define BSP_EVENT_APP0          (1<<5)  // bits for application
+#define BSP_EVENT_APP1          (1<<6)
+#define BSP_EVENT_APP2          (1<<7)
+
+
+// ****************************************************************************
+// Event bitmap control
+// ****************************************************************************
+extern volatile uint8_t bsp_events;
+
+// Set event bits from ISR (interrupts are already disabled)
+#define BSP_EVENT_SET_ISR(mask)   { bsp_events |= (mask); }
+
+// Set event bits from main loop
+void BSP_event_set(uint8_t mask);
+
+// Get all pending events and clear them
+uint8_t BSP_event_take(void);
+
+// Sleep in IDLE mode if there are no pending events, any interrupt wakes MCU up.
+// Check and sleep are atomic - event set by ISR right after check can't be lost.
+void BSP_event_wait(void);
+
+
+#endif  // BSP_EVENTS_H
@@ -6,6 +6,7 @@
 #include "bsp.h"
 #include "bsp_hal.h"
 #include "bsp_extint.h"
+#include "bsp_events.h"
 
 
 // ****************************************************************************
@@ -73,12 +74,12 @@ void BSP_extint_disable(uint8_t chan)
 // ****************************************************************************
 #ifdef EXTINT0_ENABLED
     //interrupt  [EXT_INT0] void BSP_extint0_isr(void) { EXT_INT0_isr_handler(); }   
-    ISR (INT0_vect)   { EXT_INT0_isr_handler(); } 
+    ISR (INT0_vect)   { BSP_EVENT_SET_ISR(BSP_EVENT_EXTINT); EXT_INT0_isr_handler(); } 
 #endif
 
 #ifdef EXTINT1_ENABLED
     // interrupt  [EXT_INT1] void BSP_extint1_isr(void) { EXT_INT1_isr_handler(); } 
-    ISR (INT1_vect)   { EXT_INT1_isr_handler(); }    
+    ISR (INT1_vect)   { BSP_EVENT_SET_ISR(BSP_EVENT_EXTINT); EXT_INT1_isr_handler(); }    
 #endif
 
 #ifdef EXTINT2_ENABLED
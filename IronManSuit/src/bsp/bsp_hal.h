@@ -16,7 +16,9 @@
 	#include "hal/hal_sleep.h" 
     #include "hal/hal_adc.h"
     #include "hal/hal_extint.h" 
+    #include "hal/hal_time.h" 
     #include "hal/hal_uart.h" 
+    #include "hal/hal_clock.h" 
 #endif
 
 
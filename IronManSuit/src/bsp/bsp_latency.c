@@ -0,0 +1,77 @@
+// ****************************************************************************
+// Interrupt latency measurement
+// ****************************************************************************
+//
+// To enable measurement, in external file must be defined:
+//    USE_ISR_LATENCY
+//
+// ****************************************************************************
+#include <stdint.h>
+#include "bsp.h"
+#include "bsp_hal.h"
+#include "bsp_trace.h"
+#include "bsp_latency.h"
+
+
+#ifdef USE_ISR_LATENCY
+
+// Tables for all instrumented vectors
+bspLatency_t bsp_latency[BSP_LATENCY_VECTORS_NUM] = { [0 ... BSP_LATENCY_VECTORS_NUM - 1] = { .min = 0xFF } };
+
+// Run time of async timer handlers
+bspAsyncBudget_t bsp_async_budget;
+
+// Names for output
+static const char * const latency_names[BSP_LATENCY_VECTORS_NUM] = { "T0 COMPA", "T1 OVF", "T1 COMPA", "T1 COMPB" };
+
+
+//-------------------------------------------------------------------------------
+// Print all tables to trace UART
+// Tables are copied in critical section, printed without it
+void __latency_dump(void)
+{
+    bspLatency_t lat;
+    bspAsyncBudget_t async;
+    uint8_t i;
+    BSP_USE_CRITICAL();
+
+    for (i = 0; i < BSP_LATENCY_VECTORS_NUM; i++) {
+        BSP_CRITICAL(lat = bsp_latency[i]);
+        if (lat.samples == 0) {
+            continue;
+        }
+        BSP_TRACE("ISR %s [us]: n %u min %u max %u | %u %u %u %u %u %u %u %u",
+                  latency_names[i], lat.samples, lat.min, lat.max,
+                  lat.bins[0], lat.bins[1], lat.bins[2], lat.bins[3],
+                  lat.bins[4], lat.bins[5], lat.bins[6], lat.bins[7]);
+    }
+    
+    BSP_CRITICAL(async = bsp_async_budget);
+    if (async.calls != 0) {
+        BSP_TRACE("Async handlers [cycles]: n %u max %u over budget %u", async.calls, async.max, async.overruns);
+    }
+}
+
+//-------------------------------------------------------------------------------
+// Clear all tables
+void __latency_reset(void)
+{
+    uint8_t i, j;
+    BSP_USE_CRITICAL();
+
+    BSP_CRITICAL_BEGIN();
+    for (i = 0; i < BSP_LATENCY_VECTORS_NUM; i++) {
+        bsp_latency[i].samples = 0;
+        bsp_latency[i].min = 0xFF;
+        bsp_latency[i].max = 0;
+        for (j = 0; j < BSP_LATENCY_BINS; j++) {
+            bsp_latency[i].bins[j] = 0;
+        }
+    }
+    bsp_async_budget.calls = 0;
+    bsp_async_budget.overruns = 0;
+    bsp_async_budget.max = 0;
+    BSP_CRITICAL_END();
+}
+
+#endif  // USE_ISR_LATENCY
@@ -0,0 +1,112 @@
+// ****************************************************************************
+// Interrupt latency measurement
+// ****************************************************************************
+//
+// To enable measurement, in external file must be defined:
+//    USE_ISR_LATENCY
+//
+// Each instrumented ISR takes its latency [us] on entry from time base (Timer 1):
+// Timer 1 vectors read the counter after compare match (or after TOP), Timer 0
+// vector timestamps its entry against the expected compare match moment (its 
+// own count is up to 1024us). For each vector min/max and histogram are kept 
+// in RAM and can be printed to the trace UART.
+//
+// Run time of async software timer handlers is measured by time base too and
+// checked against their budget (SWTIMER_ASYNC_BUDGET_CYCLES), overruns are 
+// printed with the latency tables.
+//
+// Without USE_ISR_LATENCY all macros are empty.
+//
+// ****************************************************************************
+#ifndef BSP_LATENCY_H
+#define BSP_LATENCY_H
+
+#include <stdint.h>
+#include "bsp.h"
+
+
+// ****************************************************************************
+// Instrumented vectors
+// ****************************************************************************
+#define BSP_LATENCY_TIMER0_COMPA   0   // software timers tick (time base against expected match)
+#define BSP_LATENCY_TIMER1_OVF     1   // time base frame start (TCNT1)
+#define BSP_LATENCY_TIMER1_COMPA   2   // servo 1 pulse end (TCNT1 - OCR1A)
+#define BSP_LATENCY_TIMER1_COMPB   3   // servo 2 pulse end (TCNT1 - OCR1B)
+#define BSP_LATENCY_VECTORS_NUM    4
+
+// Histogram with log2 bins: 0, 1, 2-3, 4-7, 8-15, 16-31, 32-63, 64 and more us
+#define BSP_LATENCY_BINS           8
+
+#if defined(USE_ISR_LATENCY) && !defined(TIMEBASE_ENABLED)
+    #error "ERROR: USE_ISR_LATENCY needs TIMEBASE_ENABLED (latency is measured by time base)"
+#endif
+
+
+// ****************************************************************************
+// BSP_LATENCY_SAMPLE(vector, us)     - save one measurement, first statement of ISR
+// BSP_LATENCY_ASYNC(cycles, budget)  - save run time of one async timer handler
+// BSP_LATENCY_DUMP()                 - print all tables to trace UART
+// BSP_LATENCY_RESET()                - clear all tables
+// ****************************************************************************
+#ifdef USE_ISR_LATENCY
+
+    typedef struct {
+        uint16_t  samples;                  // number of measurements (saturated)
+        uint8_t   min;                      // [us]
+        uint8_t   max;                      // [us]
+        uint16_t  bins[BSP_LATENCY_BINS];   // histogram (saturated)
+    } bspLatency_t;
+
+    extern bspLatency_t bsp_latency[BSP_LATENCY_VECTORS_NUM];
+
+    typedef struct {
+        uint16_t  calls;                    // number of handlers (saturated)
+        uint16_t  overruns;                 // handlers over budget (saturated)
+        uint16_t  max;                      // the longest handler [cycles] (saturated)
+    } bspAsyncBudget_t;
+
+    extern bspAsyncBudget_t bsp_async_budget;
+
+    void __latency_dump(void);
+    void __latency_reset(void);
+
+    // Inline to keep ISR prologue short (no call-clobbered registers saving)
+    static inline void __latency_sample(uint8_t vector, uint16_t us)
+    {
+        bspLatency_t * lat_p = &bsp_latency[vector];
+        uint8_t val = (us > 0xFF) ? 0xFF : (uint8_t)us;
+        uint8_t bin = 0;
+
+        while (val >> bin) {
+            if (++bin == BSP_LATENCY_BINS - 1) break;
+        }
+
+        if (val < lat_p->min) lat_p->min = val;
+        if (val > lat_p->max) lat_p->max = val;
+        if (lat_p->bins[bin] != 0xFFFF) lat_p->bins[bin]++;
+        if (lat_p->samples != 0xFFFF)   lat_p->samples++;
+    }
+
+    static inline void __async_budget_sample(uint32_t cycles, uint16_t budget)
+    {
+        uint16_t val = (cycles > 0xFFFF) ? 0xFFFF : (uint16_t)cycles;
+
+        if (val > bsp_async_budget.max) bsp_async_budget.max = val;
+        if ((val > budget) && (bsp_async_budget.overruns != 0xFFFF)) bsp_async_budget.overruns++;
+        if (bsp_async_budget.calls != 0xFFFF) bsp_async_budget.calls++;
+    }
+
+    #define BSP_LATENCY_SAMPLE(vector, us)       { __latency_sample(vector, us); }
+    #define BSP_LATENCY_ASYNC(cycles, budget)    { __async_budget_sample(cycles, budget); }
+    #define BSP_LATENCY_DUMP()                   { __latency_dump(); }
+    #define BSP_LATENCY_RESET()                  { __latency_reset(); }
+
+#else
+    #define BSP_LATENCY_SAMPLE(vector, us)       {}  // empty
+    #define BSP_LATENCY_ASYNC(cycles, budget)    {}  // empty
+    #define BSP_LATENCY_DUMP()                   {}  // empty
+    #define BSP_LATENCY_RESET()                  {}  // empty
+#endif
+
+
+#endif  // BSP_LATENCY_H
@@ -0,0 +1,146 @@
+// ****************************************************************************
+// Pin change interrupt capture
+// ****************************************************************************
+//
+// Ring buffer of timestamped port values
+//
+// ****************************************************************************
+#include <stdint.h>
+#include "bsp.h"
+#include "bsp_hal.h"
+#include "bsp_time.h"
+#include "bsp_events.h"
+#include "bsp_pcint.h"
+
+
+#ifdef PCINT1_ENABLED
+
+#if ((BSP_PCINT_RING_SIZE & (BSP_PCINT_RING_SIZE - 1)) != 0)
+    #error "ERROR: BSP_PCINT_RING_SIZE must be power of 2"
+#endif
+#define PCINT_RING_MASK    (BSP_PCINT_RING_SIZE - 1)
+
+// Ring: interrupt writes to head, main loop reads from tail
+static bspPcintEdge_t    pcint_ring[BSP_PCINT_RING_SIZE];
+static volatile uint8_t  pcint_head;
+static volatile uint8_t  pcint_tail;
+static volatile uint8_t  pcint_lost;
+static uint8_t           pcint_mask;       // captured pins
+static uint8_t           pcint_pins;       // port value of the last captured edge
+static volatile uint8_t  pcint_is_paused;  // time base is not valid (sleep)
+
+
+
+//-------------------------------------------------------------------------------
+// Init capture for pins selected by mask, ring is cleared
+void BSP_pcint_init(uint8_t mask)
+{
+    BSP_USE_CRITICAL();
+
+    BSP_CRITICAL_BEGIN();
+    pcint_head = 0;
+    pcint_tail = 0;
+    pcint_lost = 0;
+    pcint_mask = mask;
+    pcint_pins = PCINT1_PINS();
+    pcint_is_paused = 0;
+    PCINT1_INIT(mask);
+    BSP_CRITICAL_END();
+}
+
+//-------------------------------------------------------------------------------
+void BSP_pcint_enable(void)
+{
+    PCINT1_ON();
+}
+
+//-------------------------------------------------------------------------------
+void BSP_pcint_disable(void)
+{
+    PCINT1_OFF();
+}
+
+//-------------------------------------------------------------------------------
+// Get the oldest captured edge
+uint8_t BSP_pcint_get(bspPcintEdge_t * edge_p)
+{
+    uint8_t is_got = 0;
+    BSP_USE_CRITICAL();
+
+    BSP_CRITICAL_BEGIN();
+    if (pcint_tail != pcint_head) {
+        *edge_p = pcint_ring[pcint_tail];
+        pcint_tail = (pcint_tail + 1) & PCINT_RING_MASK;
+        is_got = 1;
+    }
+    BSP_CRITICAL_END();
+
+    return is_got;
+}
+
+//-------------------------------------------------------------------------------
+// Number of edges lost because of full ring
+uint8_t BSP_pcint_lost(void)
+{
+    return pcint_lost;
+}
+
+
+//-------------------------------------------------------------------------------
+// Save port value with timestamp
+// The first edge starts stopped time base, application releases it
+// Interrupts must be disabled
+static void pcint_capture(uint8_t pins)
+{
+    uint8_t head = pcint_head;
+    uint8_t next = (head + 1) & PCINT_RING_MASK;
+
+    if (!(bsp_time_users & BSP_TIME_USER_INPUT)) {
+        BSP_time_hold_isr(BSP_TIME_USER_INPUT);
+    }
+    if (next != pcint_tail) {
+        pcint_ring[head].time_us = BSP_time_us_isr();
+        pcint_ring[head].pins = pins;
+        pcint_head = next;
+    }
+    else if (pcint_lost != 0xFF) {
+        pcint_lost++;
+    }
+    pcint_pins = pins;
+}
+
+//-------------------------------------------------------------------------------
+// Sleep is started: edges are not captured
+void BSP_pcint_pause(void)
+{
+    pcint_is_paused = 1;
+}
+
+//-------------------------------------------------------------------------------
+// Peripherals are restored: port is captured if it was changed in sleep
+void BSP_pcint_resume(void)
+{
+    uint8_t pins = PCINT1_PINS();
+
+    pcint_is_paused = 0;
+    if ((pins ^ pcint_pins) & pcint_mask) {
+        pcint_capture(pins);
+        BSP_EVENT_SET_ISR(BSP_EVENT_PCINT);
+    }
+}
+
+
+//-------------------------------------------------------------------------------
+// Pin change: port is read first, then timestamp
+// Paused - MCU is woken up from sleep, edge is captured by BSP_pcint_resume()
+ISR (PCINT1_ISR_VECTOR)
+{
+    uint8_t pins = PCINT1_PINS();
+
+    if (!pcint_is_paused) {
+        pcint_capture(pins);
+    }
+    BSP_EVENT_SET_ISR(BSP_EVENT_PCINT);
+}
+
+#endif  // PCINT1_ENABLED
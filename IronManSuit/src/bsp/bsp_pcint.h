@@ -0,0 +1,70 @@
+// ****************************************************************************
+// Pin change interrupt capture
+// ****************************************************************************
+//
+// To enable capture, in external file must be defined:
+//    PCINT1_ENABLED
+//    TIMEBASE_ENABLED
+//
+// Each pin change of selected pins is captured by interrupt: port value and
+// timestamp are saved into ring buffer and BSP_EVENT_PCINT is set. Main loop
+// gets captured edges in order of occurrence.
+//
+// If ring is full, new edges are lost (counter of lost edges is kept).
+//
+// The first edge starts time base (BSP_TIME_USER_INPUT) if it is stopped, so
+// its timestamp is the moment time goes on. Application releases time base
+// when captured edges and their timeouts are processed.
+//
+// ****************************************************************************
+#ifndef BSP_PCINT_H
+#define BSP_PCINT_H
+
+#include <stdint.h>
+#include "bsp.h"
+
+
+#ifdef PCINT1_ENABLED
+
+#ifndef TIMEBASE_ENABLED
+    #error "ERROR: TIMEBASE_ENABLED must be defined for PCINT1 capture timestamps"
+#endif
+
+// Ring size (power of 2)
+#define BSP_PCINT_RING_SIZE    8
+
+
+// ****************************************************************************
+// Captured edge
+// ****************************************************************************
+typedef struct {
+    uint32_t  time_us;  // timestamp from BSP_time_us()
+    uint8_t   pins;     // port value right after change
+} bspPcintEdge_t;
+
+
+// ****************************************************************************
+// Pin change capture control
+// ****************************************************************************
+// Init capture for pins selected by mask, ring is cleared
+void BSP_pcint_init(uint8_t mask);
+
+void BSP_pcint_enable(void);
+void BSP_pcint_disable(void);
+
+// Get the oldest captured edge. Returns 0 if ring is empty.
+uint8_t BSP_pcint_get(bspPcintEdge_t * edge_p);
+
+// Number of edges lost because of full ring (saturated)
+uint8_t BSP_pcint_lost(void);
+
+// Sleep with gated peripherals: interrupt which wakes MCU up is served before time base
+// is restored. While paused, interrupt only sets BSP_EVENT_PCINT, resume captures 
+// the port if it differs from the last captured value. Interrupts must be disabled.
+void BSP_pcint_pause(void);
+void BSP_pcint_resume(void);
+
+#endif  // PCINT1_ENABLED
+
+
+#endif  // BSP_PCINT_H
@@ -0,0 +1,74 @@
+// ****************************************************************************
+// Peripheral power manager
+// ****************************************************************************
+//
+// Users counter per block, PRR bit is changed on 0 <-> 1 transitions only
+//
+// ****************************************************************************
+#include <stdint.h>
+#include "bsp.h"
+#include "bsp_hal.h"
+#include "bsp_trace.h"
+#include "bsp_power.h"
+
+
+static const uint8_t power_bits[BSP_POWER_BLOCKS_NUM] = POWER_BLOCK_BITS;
+static uint8_t       power_users[BSP_POWER_BLOCKS_NUM];
+
+
+
+//-------------------------------------------------------------------------------
+// Gate all blocks, no users
+void BSP_power_init(void)
+{
+    BSP_USE_CRITICAL();
+
+    BSP_CRITICAL_BEGIN();
+    POWER_ALL_DISABLE();
+    for (uint8_t i = 0; i < BSP_POWER_BLOCKS_NUM; ++i) {
+        power_users[i] = 0;
+    }
+    BSP_CRITICAL_END();
+}
+
+//-------------------------------------------------------------------------------
+// Ungate block if it is the first user
+// Can be called from interrupt (block is ungated right after return)
+void BSP_power_acquire(bspPowerBlock_t block)
+{
+    BSP_USE_CRITICAL();
+
+    BSP_ASSERT(block < BSP_POWER_BLOCKS_NUM);
+
+    BSP_CRITICAL_BEGIN();
+    if (power_users[block]++ == 0) {
+        POWER_MASK_ENABLE(power_bits[block]);
+    }
+    BSP_CRITICAL_END();
+}
+
+//-------------------------------------------------------------------------------
+// Gate block if it is the last user
+void BSP_power_release(bspPowerBlock_t block)
+{
+    BSP_USE_CRITICAL();
+
+    BSP_ASSERT(block < BSP_POWER_BLOCKS_NUM);
+
+    BSP_CRITICAL_BEGIN();
+    BSP_ASSERT(power_users[block] != 0);
+    if ((power_users[block] != 0) && (--power_users[block] == 0)) {
+        POWER_MASK_DISABLE(power_bits[block]);
+    }
+    BSP_CRITICAL_END();
+}
+
+//-------------------------------------------------------------------------------
+// Number of block users
+uint8_t BSP_power_users(bspPowerBlock_t block)
+{
+    uint8_t users;
+    BSP_USE_CRITICAL();
+    BSP_CRITICAL(users = power_users[block]);
+    return users;
+}
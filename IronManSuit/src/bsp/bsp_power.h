@@ -0,0 +1,51 @@
+// ****************************************************************************
+// Peripheral power manager
+// ****************************************************************************
+//
+// Each driver acquires its block before use and releases it after. Block
+// clock is ungated by the first acquire and gated by the last release, so
+// unused blocks are gated all the time (not only after start).
+//
+// Acquire/release must be paired. Drivers with enable/disable API keep
+// their own flag, so repeated enable doesn't acquire block twice.
+//
+// ****************************************************************************
+#ifndef BSP_POWER_H
+#define BSP_POWER_H
+
+#include <stdint.h>
+#include "bsp.h"
+
+
+// ****************************************************************************
+// Blocks with power reduction bit
+// ****************************************************************************
+typedef enum {
+    BSP_POWER_ADC,
+    BSP_POWER_UART,
+    BSP_POWER_TIMER0,
+    BSP_POWER_TIMER1,
+    BSP_POWER_TIMER2,
+    BSP_POWER_SPI,
+    BSP_POWER_TWI,
+    BSP_POWER_BLOCKS_NUM
+} bspPowerBlock_t;
+
+
+// ****************************************************************************
+// Power manager control
+// ****************************************************************************
+// Gate all blocks, no users (must be called before any driver init)
+void BSP_power_init(void);
+
+// Ungate block if it is the first user
+void BSP_power_acquire(bspPowerBlock_t block);
+
+// Gate block if it is the last user
+void BSP_power_release(bspPowerBlock_t block);
+
+// Number of block users
+uint8_t BSP_power_users(bspPowerBlock_t block);
+
+
+#endif  // BSP_POWER_H
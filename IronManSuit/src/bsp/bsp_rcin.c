@@ -0,0 +1,163 @@
+// ****************************************************************************
+// RC receiver input
+// ****************************************************************************
+//
+// Pulse width measurement in pin change interrupt, median of three filter
+//
+// ****************************************************************************
+#include <stdint.h>
+#include "bsp.h"
+#include "bsp_hal.h"
+#include "bsp_time.h"
+#include "bsp_events.h"
+#include "bsp_rcin.h"
+
+
+#ifdef RCIN_ENABLED
+
+// ----------------------------------------------------------------------------
+typedef struct {
+    uint16_t  rise_us;      // low 16 bits of pulse start time
+    uint16_t  last[3];      // the last valid pulses
+    uint8_t   idx;          // the oldest pulse in last[]
+    volatile uint16_t width_us;   // filtered width
+} rcin_chan_t;
+
+static rcin_chan_t        rcin_chans[BSP_RCIN_CHANNELS];
+static uint8_t            rcin_mask;
+static uint8_t            rcin_pins;       // pins value before change
+static volatile uint32_t  rcin_last_us;
+
+
+
+//-------------------------------------------------------------------------------
+// Median of three
+static uint16_t rcin_median(uint16_t a, uint16_t b, uint16_t c)
+{
+    if (a > b) { uint16_t t = a; a = b; b = t; }
+    if (b > c) { b = c; }
+    return (a > b) ? a : b;
+}
+
+
+
+//-------------------------------------------------------------------------------
+// Init pins of channels selected by mask, channels are cleared
+void BSP_rcin_init(uint8_t mask)
+{
+    BSP_USE_CRITICAL();
+
+    mask &= (1 << BSP_RCIN_CHANNELS) - 1;
+
+    BSP_CRITICAL_BEGIN();
+    RCIN_INIT(mask);
+    rcin_mask = mask;
+    rcin_pins = RCIN_PINS();
+    rcin_last_us = 0;
+    for (uint8_t i = 0; i < BSP_RCIN_CHANNELS; ++i) {
+        rcin_chans[i].idx = 0;
+        rcin_chans[i].width_us = 0;
+    }
+    BSP_CRITICAL_END();
+}
+
+//-------------------------------------------------------------------------------
+void BSP_rcin_enable(void)
+{
+    BSP_time_hold(BSP_TIME_USER_DECODER);
+    RCIN_ON();
+}
+
+//-------------------------------------------------------------------------------
+void BSP_rcin_disable(void)
+{
+    RCIN_OFF();
+    BSP_time_release(BSP_TIME_USER_DECODER);
+}
+
+//-------------------------------------------------------------------------------
+// Filtered pulse width of channel
+uint16_t BSP_rcin_width_us(uint8_t chan)
+{
+    uint16_t width;
+    BSP_USE_CRITICAL();
+
+    if (chan >= BSP_RCIN_CHANNELS) {
+        return 0;
+    }
+    BSP_CRITICAL(width = rcin_chans[chan].width_us);
+    return width;
+}
+
+//-------------------------------------------------------------------------------
+// Filtered position of channel
+// 255/1000 is replaced by 261/1024 (error is less than one step)
+uint8_t BSP_rcin_position(uint8_t chan)
+{
+    uint16_t width = BSP_rcin_width_us(chan);
+
+    if (width <= BSP_RCIN_MIN_US) {
+        return 0;
+    }
+    if (width >= BSP_RCIN_MAX_US) {
+        return BSP_RCIN_POS_MAX;
+    }
+#if ((BSP_RCIN_MAX_US - BSP_RCIN_MIN_US) == 1000) && (BSP_RCIN_POS_MAX == 255)
+    return (uint8_t)(((uint32_t)(width - BSP_RCIN_MIN_US) * 261UL) >> 10);
+#else
+    return (uint8_t)((uint32_t)(width - BSP_RCIN_MIN_US) * BSP_RCIN_POS_MAX / (BSP_RCIN_MAX_US - BSP_RCIN_MIN_US));
+#endif
+}
+
+//-------------------------------------------------------------------------------
+// Time of the last valid pulse of any channel
+uint32_t BSP_rcin_last_us(void)
+{
+    uint32_t time;
+    BSP_USE_CRITICAL();
+    BSP_CRITICAL(time = rcin_last_us);
+    return time;
+}
+
+
+//-------------------------------------------------------------------------------
+// Pin change: rising edge starts pulse, falling edge measures it.
+// Pulses are much shorter than 65 ms, so 16-bit time difference is enough.
+ISR (RCIN_ISR_VECTOR)
+{
+    uint8_t  pins = RCIN_PINS();
+    uint32_t now_us = BSP_time_us_isr();
+    uint8_t  changed = (pins ^ rcin_pins) & rcin_mask;
+    rcin_chan_t * ch_p = rcin_chans;
+
+    rcin_pins = pins;
+
+    for (uint8_t mask = 1; changed; mask <<= 1, ++ch_p) {
+        if (!(changed & mask)) {
+            continue;
+        }
+        changed &= ~mask;
+
+        if (pins & mask) {
+            ch_p->rise_us = (uint16_t)now_us;
+        }
+        else {
+            uint16_t width = (uint16_t)now_us - ch_p->rise_us;
+
+            if ((width >= BSP_RCIN_VALID_MIN_US) && (width <= BSP_RCIN_VALID_MAX_US)) {
+                // The first pulse fills the whole filter
+                if (ch_p->width_us == 0) {
+                    ch_p->last[1] = width;
+                    ch_p->last[2] = width;
+                }
+                ch_p->last[ch_p->idx] = width;
+                if (++ch_p->idx >= 3) ch_p->idx = 0;
+                ch_p->width_us = rcin_median(ch_p->last[0], ch_p->last[1], ch_p->last[2]);
+                rcin_last_us = now_us;
+                BSP_EVENT_SET_ISR(BSP_EVENT_RCIN);
+            }
+        }
+    }
+}
+
+#endif  // RCIN_ENABLED
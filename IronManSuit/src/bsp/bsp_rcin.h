@@ -0,0 +1,63 @@
+// ****************************************************************************
+// RC receiver input
+// ****************************************************************************
+//
+// To enable capture, in external file must be defined:
+//    RCIN_ENABLED
+//    TIMEBASE_ENABLED
+//
+// Hobby RC receiver outputs servo pulses (1..2 ms every ~20 ms) for each
+// channel. Channel n is connected to PCn (n = 0..3). Pin change interrupt
+// timestamps both edges of the pulse and measures its width right away, so
+// main loop latency does not matter.
+//
+// Pulses out of BSP_RCIN_VALID_MIN_US..BSP_RCIN_VALID_MAX_US are rejected.
+// Channel width is the median of the last three valid pulses: single glitch
+// is rejected, stick movement is delayed by one frame only.
+//
+// ****************************************************************************
+#ifndef BSP_RCIN_H
+#define BSP_RCIN_H
+
+#include <stdint.h>
+#include "bsp.h"
+
+
+#ifdef RCIN_ENABLED
+
+#ifndef TIMEBASE_ENABLED
+    #error "ERROR: TIMEBASE_ENABLED must be defined for RC pulses capture"
+#endif
+
+// Capture settings
+#define BSP_RCIN_CHANNELS       4           // channels 0..3 on PC0..PC3
+#define BSP_RCIN_MIN_US         1000        // stick in the lowest position [us]
+#define BSP_RCIN_MAX_US         2000        // stick in the highest position [us]
+#define BSP_RCIN_VALID_MIN_US   800         // shorter pulse is a glitch [us]
+#define BSP_RCIN_VALID_MAX_US   2200        // longer pulse is a glitch [us]
+
+#define BSP_RCIN_POS_MAX        255         // position of the highest stick position
+
+
+// ****************************************************************************
+// Capture control
+// ****************************************************************************
+// Init pins of channels selected by mask (bit n - channel n), channels are cleared
+void BSP_rcin_init(uint8_t mask);
+
+void BSP_rcin_enable(void);
+void BSP_rcin_disable(void);
+
+// Filtered pulse width of channel [us], 0 - no valid pulses yet
+uint16_t BSP_rcin_width_us(uint8_t chan);
+
+// Filtered position of channel: 0..BSP_RCIN_POS_MAX for BSP_RCIN_MIN_US..BSP_RCIN_MAX_US
+uint8_t BSP_rcin_position(uint8_t chan);
+
+// Time of the last valid pulse of any channel [us]
+uint32_t BSP_rcin_last_us(void);
+
+#endif  // RCIN_ENABLED
+
+
+#endif  // BSP_RCIN_H
@@ -0,0 +1,256 @@
+// ****************************************************************************
+// RF remote codes decoder (EV1527 / PT2262)
+// ****************************************************************************
+//
+// Pulse width decoder in INT0 interrupt, ring buffer of accepted codes
+//
+// ****************************************************************************
+#include <stdint.h>
+#include "bsp.h"
+#include "bsp_hal.h"
+#include "bsp_time.h"
+#include "bsp_events.h"
+#include "bsp_timers.h"
+#include "bsp_rfrx.h"
+
+
+#ifdef RFRX_ENABLED
+
+#if ((BSP_RFRX_RING_SIZE & (BSP_RFRX_RING_SIZE - 1)) != 0)
+    #error "ERROR: BSP_RFRX_RING_SIZE must be power of 2"
+#endif
+#define RFRX_RING_MASK     (BSP_RFRX_RING_SIZE - 1)
+
+// Sync low is 31T (T is calculated as low/32 - close enough for 25% tolerance)
+#define RFRX_SYNC_MIN_US   (31UL * BSP_RFRX_T_MIN_US)
+#define RFRX_SYNC_MAX_US   (31UL * BSP_RFRX_T_MAX_US)
+
+#if (RFRX_SYNC_MAX_US > 0xFFFF)
+    #error "ERROR: BSP_RFRX_T_MAX_US is too long for 16-bit pulse width"
+#endif
+#if (BSP_RFRX_GLITCH_US >= BSP_RFRX_T_MIN_US)
+    #error "ERROR: BSP_RFRX_GLITCH_US must be shorter than BSP_RFRX_T_MIN_US"
+#endif
+
+
+// ----------------------------------------------------------------------------
+// Decoder state (interrupt context only)
+static uint32_t  rfrx_edge_us;       // time of the previous edge
+static uint16_t  rfrx_edge_cnt;      // hw-timer counter at the previous edge (noise filter)
+static uint8_t   rfrx_noise_cnt;     // noise pulses in a row
+static uint16_t  rfrx_high_us;       // width of the last high pulse
+static uint16_t  rfrx_bit_min_us;    // 3T - the shortest bit
+static uint16_t  rfrx_bit_max_us;    // 5T - the longest bit
+static uint8_t   rfrx_bits;          // received bits, 0xFF - wait sync
+static uint32_t  rfrx_code;          // bits of current frame
+static uint8_t   rfrx_frames;        // equal frames in a row
+
+// Last valid frame
+static volatile uint32_t rfrx_last_code;
+static volatile uint32_t rfrx_last_us;
+
+// Ring: interrupt writes to head, main loop reads from tail
+static bspRfrxCode_t     rfrx_ring[BSP_RFRX_RING_SIZE];
+static volatile uint8_t  rfrx_head;
+static volatile uint8_t  rfrx_tail;
+
+static volatile uint8_t  rfrx_is_enabled;
+
+#define RFRX_WAIT_SYNC     0xFF
+
+
+
+//-------------------------------------------------------------------------------
+// Frame is received (interrupt context)
+static void rfrx_frame(uint32_t code, uint32_t time_us)
+{
+    // Repeat of the same code
+    if ((code == rfrx_last_code) && ((time_us - rfrx_last_us) < BSP_RFRX_REPEAT_US)) {
+        if (rfrx_frames < BSP_RFRX_FRAMES_MIN) {
+            if (++rfrx_frames == BSP_RFRX_FRAMES_MIN) {
+                // Accepted - report once
+                uint8_t next = (rfrx_head + 1) & RFRX_RING_MASK;
+                if (next != rfrx_tail) {
+                    rfrx_ring[rfrx_head].code = code;
+                    rfrx_ring[rfrx_head].time_us = time_us;
+                    rfrx_head = next;
+                }
+                BSP_EVENT_SET_ISR(BSP_EVENT_RFRX);
+            }
+        }
+    }
+    else {
+        rfrx_frames = 1;
+    }
+
+    rfrx_last_code = code;
+    rfrx_last_us = time_us;
+}
+
+//-------------------------------------------------------------------------------
+// Noise burst is over (TMR_RFRX_NOISE, timer interrupt context)
+static void rfrx_noise_end(void)
+{
+    if (rfrx_is_enabled) {
+        RFRX_IRQ_FLAG_CLR();
+        RFRX_ON();
+    }
+}
+
+//-------------------------------------------------------------------------------
+// Too short pulse: frame is broken, interrupt is masked for a while after burst
+// (interrupt context)
+static void rfrx_noise(void)
+{
+    rfrx_bits = RFRX_WAIT_SYNC;
+    if (++rfrx_noise_cnt >= BSP_RFRX_NOISE_PULSES) {
+        rfrx_noise_cnt = 0;
+        RFRX_OFF();
+        BSP_timer_start_ms(TMR_RFRX_NOISE, BSP_RFRX_NOISE_MASK_MS, SWTIMER_SINGLE_ASYNC, rfrx_noise_end);
+    }
+}
+
+//-------------------------------------------------------------------------------
+// Low pulse is finished: decode pair of high and low pulses (interrupt context)
+static void rfrx_pulse(uint16_t low_us, uint32_t time_us)
+{
+    uint16_t high_us = rfrx_high_us;
+    uint16_t sum_us;
+
+    // Sync: short high, very long low. T is measured from it.
+    if ((low_us >= RFRX_SYNC_MIN_US) && (low_us <= RFRX_SYNC_MAX_US) && (high_us < (low_us >> 4))) {
+        uint16_t t_us = low_us >> 5;
+        rfrx_bit_min_us = t_us * 3;
+        rfrx_bit_max_us = t_us * 5;
+        rfrx_bits = 0;
+        rfrx_code = 0;
+        return;
+    }
+
+    if (rfrx_bits == RFRX_WAIT_SYNC) {
+        return;
+    }
+
+    // Bit: 4T in total, the longer pulse is the value
+    sum_us = high_us + low_us;
+    if ((sum_us < rfrx_bit_min_us) || (sum_us > rfrx_bit_max_us)) {
+        rfrx_bits = RFRX_WAIT_SYNC;
+        return;
+    }
+    rfrx_code = (rfrx_code << 1) | (high_us > low_us);
+
+    if (++rfrx_bits == BSP_RFRX_CODE_BITS) {
+        rfrx_bits = RFRX_WAIT_SYNC;
+        rfrx_frame(rfrx_code, time_us);
+    }
+}
+
+
+
+//-------------------------------------------------------------------------------
+// Init INT0 pin and decoder, ring is cleared
+void BSP_rfrx_init(void)
+{
+    BSP_USE_CRITICAL();
+
+    BSP_CRITICAL_BEGIN();
+    RFRX_INIT();
+    rfrx_bits = RFRX_WAIT_SYNC;
+    rfrx_frames = 0;
+    rfrx_last_code = 0;
+    rfrx_last_us = 0;
+    rfrx_noise_cnt = 0;
+    rfrx_head = 0;
+    rfrx_tail = 0;
+    BSP_CRITICAL_END();
+}
+
+//-------------------------------------------------------------------------------
+void BSP_rfrx_enable(void)
+{
+    BSP_time_hold(BSP_TIME_USER_DECODER);
+    rfrx_is_enabled = 1;
+    RFRX_ON();
+}
+
+//-------------------------------------------------------------------------------
+void BSP_rfrx_disable(void)
+{
+    rfrx_is_enabled = 0;
+    RFRX_OFF();
+    BSP_timer_stop(TMR_RFRX_NOISE);
+    BSP_time_release(BSP_TIME_USER_DECODER);
+}
+
+//-------------------------------------------------------------------------------
+// Get the oldest accepted code
+uint8_t BSP_rfrx_get(bspRfrxCode_t * code_p)
+{
+    uint8_t is_got = 0;
+    BSP_USE_CRITICAL();
+
+    BSP_CRITICAL_BEGIN();
+    if (rfrx_tail != rfrx_head) {
+        *code_p = rfrx_ring[rfrx_tail];
+        rfrx_tail = (rfrx_tail + 1) & RFRX_RING_MASK;
+        is_got = 1;
+    }
+    BSP_CRITICAL_END();
+
+    return is_got;
+}
+
+//-------------------------------------------------------------------------------
+// Time of the last valid frame
+uint32_t BSP_rfrx_last_us(void)
+{
+    uint32_t time;
+    BSP_USE_CRITICAL();
+    BSP_CRITICAL(time = rfrx_last_us);
+    return time;
+}
+
+//-------------------------------------------------------------------------------
+// Code of the last valid frame
+uint32_t BSP_rfrx_last_code(void)
+{
+    uint32_t code;
+    BSP_USE_CRITICAL();
+    BSP_CRITICAL(code = rfrx_last_code);
+    return code;
+}
+
+
+//-------------------------------------------------------------------------------
+// Data pin is changed: measure previous pulse
+// Noise is rejected by hw-timer counts: difference is wrong only if counter has wrapped
+// at frame end, then it is huge and pulse is measured by 32-bit time
+ISR (RFRX_ISR_VECTOR)
+{
+    uint8_t  is_high = RFRX_IS_HIGH();
+    uint16_t cnt = TIME_COUNTER();
+    uint32_t now_us, width_us;
+    uint16_t width;
+
+    width = cnt - rfrx_edge_cnt;
+    rfrx_edge_cnt = cnt;
+    if (width < (BSP_RFRX_GLITCH_US >> bsp_time_shift)) {
+        rfrx_noise();
+        return;
+    }
+    rfrx_noise_cnt = 0;
+
+    now_us = BSP_time_us_isr();
+    width_us = now_us - rfrx_edge_us;
+    width = (width_us > 0xFFFF) ? 0xFFFF : (uint16_t)width_us;
+    rfrx_edge_us = now_us;
+
+    if (is_high) {
+        rfrx_pulse(width, now_us);   // low pulse is finished
+    }
+    else {
+        rfrx_high_us = width;        // high pulse is finished
+    }
+}
+
+#endif  // RFRX_ENABLED
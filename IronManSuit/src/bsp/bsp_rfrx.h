@@ -0,0 +1,86 @@
+// ****************************************************************************
+// RF remote codes decoder (EV1527 / PT2262)
+// ****************************************************************************
+//
+// To enable decoder, in external file must be defined:
+//    RFRX_ENABLED
+//    TIMEBASE_ENABLED
+//
+// OOK data output of plain RF receiver is connected to INT0 pin. Interrupt
+// on any change timestamps each edge and decodes pulses right away:
+//
+//    sync:   1T high, 31T low
+//    bit 0:  1T high,  3T low
+//    bit 1:  3T high,  1T low
+//    frame:  sync + 24 bits (PT2262 12 tri-state bits are 24 bits too)
+//
+// Pulse width T is measured from each sync, so remotes with any T in range
+// BSP_RFRX_T_MIN_US..BSP_RFRX_T_MAX_US are decoded. Remote repeats the frame
+// while button is held: code is reported once, when BSP_RFRX_FRAMES_MIN equal
+// frames are received in a row. The next repeats only update time of the last
+// valid frame, so held button costs nothing for main loop.
+//
+// Receiver without signal outputs noise (its gain is maximal). Pulses shorter
+// than BSP_RFRX_GLITCH_US are rejected by 16-bit hw-timer counts before 32-bit
+// time is taken. After BSP_RFRX_NOISE_PULSES such pulses in a row INT0 is masked 
+// for BSP_RFRX_NOISE_MASK_MS (software timer TMR_RFRX_NOISE), it is shorter than 
+// time between repeated frames.
+//
+// ****************************************************************************
+#ifndef BSP_RFRX_H
+#define BSP_RFRX_H
+
+#include <stdint.h>
+#include "bsp.h"
+
+
+#ifdef RFRX_ENABLED
+
+#ifndef TIMEBASE_ENABLED
+    #error "ERROR: TIMEBASE_ENABLED must be defined for RF decoder timestamps"
+#endif
+
+// Decoder settings
+#define BSP_RFRX_T_MIN_US       150         // the shortest pulse width T [us]
+#define BSP_RFRX_T_MAX_US       800         // the longest pulse width T [us]
+#define BSP_RFRX_FRAMES_MIN     2           // equal frames in a row to accept code
+#define BSP_RFRX_REPEAT_US      150000UL    // the longest time between repeated frames [us]
+#define BSP_RFRX_RING_SIZE      4           // codes waiting for main loop (power of 2)
+#define BSP_RFRX_GLITCH_US      100         // shorter pulse is noise (less than BSP_RFRX_T_MIN_US)
+#define BSP_RFRX_NOISE_PULSES   32          // noise pulses in a row to mask interrupt
+#define BSP_RFRX_NOISE_MASK_MS  100         // interrupt is masked for this time [ms]
+
+#define BSP_RFRX_CODE_BITS      24
+
+
+// ****************************************************************************
+// Received code
+// ****************************************************************************
+typedef struct {
+    uint32_t  code;      // 24-bit code (the first received bit is the most significant)
+    uint32_t  time_us;   // end of the frame which validates the code
+} bspRfrxCode_t;
+
+
+// ****************************************************************************
+// Decoder control
+// ****************************************************************************
+// Init INT0 pin and decoder, ring is cleared
+void BSP_rfrx_init(void);
+
+void BSP_rfrx_enable(void);
+void BSP_rfrx_disable(void);
+
+// Get the oldest accepted code. Returns 0 if there are no codes.
+uint8_t BSP_rfrx_get(bspRfrxCode_t * code_p);
+
+// Time of the last valid frame (accepted code or its repeat) [us]
+uint32_t BSP_rfrx_last_us(void);
+
+// Code of the last valid frame
+uint32_t BSP_rfrx_last_code(void);
+
+#endif  // RFRX_ENABLED
+
+
+#endif  // BSP_RFRX_H
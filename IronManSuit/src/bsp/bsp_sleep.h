@@ -5,7 +5,15 @@
 #ifndef BSP_SLEEP_H
 #define BSP_SLEEP_H
 
+#include <stdint.h>
 #include "bsp.h"
+#include "bsp_hal.h"
+
+
+// ****************************************************************************
+// Sleep timer debug
+// ****************************************************************************
+//#define SLEEP_TIMER_DEBUG   // debug output for sleep timer start and fire (blocks on UART)
 
 
 // ****************************************************************************
@@ -22,6 +30,19 @@
     #define BSP_POWER_SAVE_MODE()      SLEEP_POWER_SAVE_MODE();
 #endif
 
+// Complete power-down: UART is drained and disabled, timers 0/1 are stopped, ADC is
+// disabled, all clocks are gated by PRR. Pin change (buttons, RF data pin) wakes MCU up,
+// everything is restored in reverse order.
+// Timers don't count in power-down: time base and software timers are paused.
+// Returns wake-to-ready time [us] (oscillator start-up time is not included).
+uint16_t BSP_power_down(void);
+
+// Power-save: the same as power-down, but Timer2 keeps running. Its interrupts
+// (sleep timer, ambient animation) are served in sleep, MCU is woken up
+// completely by pin change or any pending event (e.g. sleep timer is fired).
+// Timers 0/1 are stopped as in power-down: sleep timer must not count software timers.
+uint16_t BSP_power_save(void);
+
 // ****************************************************************************
 // POWER REDUCTION
 // ****************************************************************************
@@ -42,8 +63,14 @@
 #define BSP_POWER_ADC_ENABLE()       POWER_ADC_ENABLE();
 #define BSP_POWER_ADC_DISABLE()      POWER_ADC_DISABLE();
 
+#define BSP_POWER_TIMER0_ENABLE()    POWER_TIMER0_ENABLE();
+#define BSP_POWER_TIMER0_DISABLE()   POWER_TIMER0_DISABLE();
+
 #define BSP_POWER_TIMER1_ENABLE()    POWER_TIMER1_ENABLE();
-#define BSP_POWER_TIMER1_DISABLE()   POWER_TIMER1_ENABLE();
+#define BSP_POWER_TIMER1_DISABLE()   POWER_TIMER1_DISABLE();
+
+#define BSP_POWER_TIMER2_ENABLE()    POWER_TIMER2_ENABLE();
+#define BSP_POWER_TIMER2_DISABLE()   POWER_TIMER2_DISABLE();
 
 #define BSP_POWER_SPI_ENABLE()       POWER_SPI_ENABLE();
 #define BSP_POWER_SPI_DISABLE()      POWER_SPI_DISABLE();
@@ -87,9 +114,39 @@
     // Start sleep timer with period in milliseconds
     void BSP_sleep_timer_start_ms(uint32_t timeout_ms, sleepTimerHandler handler);
     
+    // Start sleep timer with period in milliseconds, handler is called from sleep timer ISR
+    // Handler must be short, it is executed with interrupts disabled
+    void BSP_sleep_timer_start_async_ms(uint32_t timeout_ms, sleepTimerHandler handler);
+    
+    // Check if sleep timer is started and not fired yet
+    uint8_t BSP_sleep_timer_is_run(void);
+    
+    // Stop sleep timer without calling handler
+    // Returns time [ms] elapsed from start (0 if timer was not started)
+    uint32_t BSP_sleep_timer_stop(void);
+    
     // Check sleep timer and call event handler
     void BSP_sleep_timer_process();
 
+
+    // Ambient animation: AMBIENT_LED is driven by Timer2 PWM (AMBIENT_FRAME_HZ frames),
+    // its brightness is stepped from table. Timer2 runs in power-save, MCU is awake 
+    // only for two short interrupts per frame. Start of sleep timer stops animation.
+
+    // Start animation: levels (0..255, table in flash) are taken one by one in a loop,
+    // each level lasts frames_per_step frames. Returns 0 if sleep timer is started
+    // (tickless chain of software timers does not count: it is taken back to hw-timer).
+    uint8_t BSP_ambient_start(const uint8_t * levels_p, uint8_t levels_num, uint8_t frames_per_step);
+
+    // Stop animation, LED is off
+    void BSP_ambient_stop(void);
+
+    uint8_t BSP_ambient_is_run(void);
+
+    // Time of animation and LED on-time after start [ms] (energy accounting).
+    // Values are kept after stop until the next start.
+    void BSP_ambient_time(uint32_t * run_ms_p, uint32_t * led_ms_p);
+
 #endif
 
 
@@ -0,0 +1,144 @@
+// ****************************************************************************
+// Microseconds time base
+// ****************************************************************************
+//
+// Timer 1 overflow counts frames, counter gives microseconds inside frame
+//
+// ****************************************************************************
+#include <stdint.h>
+#include <stddef.h>
+#include "bsp.h"
+#include "bsp_hal.h"
+#include "bsp_time.h"
+#include "bsp_latency.h"
+#include "bsp_power.h"
+
+
+#ifdef TIMEBASE_ENABLED
+
+// Time of the current frame start [us]
+volatile uint32_t bsp_time_frame_us;
+
+// Counts of hw-timer are 1us (until system clock is changed)
+uint8_t bsp_time_shift;
+
+// Users of time base, hw-timer runs while it is not zero
+volatile uint8_t bsp_time_users;
+
+// Hw-timer clock select for current system clock (see BSP_time_clock_set)
+#ifdef CLOCK_SCALING_ENABLED
+static uint8_t time_cs = TIME_CS;
+#else
+    #define time_cs             TIME_CS
+#endif
+
+// Frame start handler
+static volatile bspTimeHandler time_frame_handler;
+
+
+//-------------------------------------------------------------------------------
+// Init hw-timer, time starts from zero
+// Hw-timer is left stopped and gated until the first user
+void BSP_time_init(void)
+{
+    BSP_USE_CRITICAL();
+
+    BSP_CRITICAL_BEGIN();
+    bsp_time_frame_us = 0;
+    bsp_time_users = 0;
+    time_frame_handler = NULL;
+    BSP_power_acquire(BSP_POWER_TIMER1);
+    TIME_INIT();
+    BSP_power_release(BSP_POWER_TIMER1);
+    BSP_CRITICAL_END();
+}
+
+//-------------------------------------------------------------------------------
+// The first user: time goes on from the value it was stopped at (new frame starts)
+void BSP_time_hold_isr(uint8_t user)
+{
+    if (!bsp_time_users) {
+        BSP_power_acquire(BSP_POWER_TIMER1);
+        TIME_RUN(time_cs, bsp_time_shift);
+    }
+    bsp_time_users |= user;
+}
+
+//-------------------------------------------------------------------------------
+// The last user: time is saved as frame start, hw-timer is stopped and gated
+void BSP_time_release_isr(uint8_t user)
+{
+    if (!(bsp_time_users & user)) {
+        return;
+    }
+    if (bsp_time_users == user) {
+        bsp_time_frame_us = BSP_time_us_isr();
+        TIME_HALT();
+        BSP_power_release(BSP_POWER_TIMER1);
+    }
+    bsp_time_users &= ~user;
+}
+
+//-------------------------------------------------------------------------------
+void BSP_time_hold(uint8_t user)
+{
+    BSP_USE_CRITICAL();
+    BSP_CRITICAL(BSP_time_hold_isr(user));
+}
+
+//-------------------------------------------------------------------------------
+void BSP_time_release(uint8_t user)
+{
+    BSP_USE_CRITICAL();
+    BSP_CRITICAL(BSP_time_release_isr(user));
+}
+
+//-------------------------------------------------------------------------------
+// Current time [us]
+uint32_t BSP_time_us(void)
+{
+    uint32_t time;
+    BSP_USE_CRITICAL();
+    BSP_CRITICAL(time = BSP_time_us_isr());
+    return time;
+}
+
+//-------------------------------------------------------------------------------
+// Set/clear (NULL) handler for frame start
+void BSP_time_set_frame_handler(bspTimeHandler handler)
+{
+    BSP_USE_CRITICAL();
+    BSP_CRITICAL(time_frame_handler = handler);
+}
+
+
+#ifdef CLOCK_SCALING_ENABLED
+//-------------------------------------------------------------------------------
+// New hw-timer clock select for new system clock
+// Current time and servo pulses are kept, frame duration is the same
+void BSP_time_clock_set(uint8_t cs, uint8_t shift)
+{
+    // Stopped hw-timer gets new settings when it is started
+    if (bsp_time_users) {
+        TIME_RETUNE(cs, bsp_time_shift, shift);
+    }
+    time_cs = cs;
+    bsp_time_shift = shift;
+}
+#endif
+
+
+//-------------------------------------------------------------------------------
+// Frame end
+ISR (TIME_OVF_VECTOR)
+{
+    BSP_LATENCY_SAMPLE(BSP_LATENCY_TIMER1_OVF, TIME_COUNTER() << bsp_time_shift);
+
+    bspTimeHandler handler = time_frame_handler;
+    bsp_time_frame_us += TIME_FRAME_US;
+    if (handler != NULL) {
+        handler();
+    }
+}
+
+#endif  // TIMEBASE_ENABLED
@@ -0,0 +1,102 @@
+// ****************************************************************************
+// Microseconds time base
+// ****************************************************************************
+//
+// To enable time base, in external file must be defined:
+//    TIMEBASE_ENABLED
+//
+// Hw-timer counts microseconds, its overflow interrupt adds frame duration
+// to the 32-bit time. Time wraps every ~71 minutes, so only differences of 
+// two timestamps must be used.
+//
+// Hw-timer runs only while time base has users (edges capture, RF/RC decoders,
+// servo frames, ADC scan trigger). Without users its clock is gated and time
+// stands still: intervals which include such pause are shorter than real ones.
+//
+// Optional frame handler is called from the overflow interrupt at the start
+// of each frame (e.g. to start servo pulses).
+//
+// ****************************************************************************
+#ifndef BSP_TIME_H
+#define BSP_TIME_H
+
+#include <stdint.h>
+#include "bsp.h"
+#include "bsp_hal.h"
+
+
+#ifdef TIMEBASE_ENABLED
+
+// Frame handler (interrupt context)
+typedef void (*bspTimeHandler)(void);
+
+// Time of the current frame start [us] (updated by overflow interrupt only)
+extern volatile uint32_t bsp_time_frame_us;
+
+// One count of hw-timer is (1 << bsp_time_shift) us (system clock scaling)
+extern uint8_t bsp_time_shift;
+
+// Users of time base (BSP_TIME_USER_xxx bits), 0 - hw-timer is stopped
+extern volatile uint8_t bsp_time_users;
+
+#define BSP_TIME_USER_INPUT     (1<<0)  // edges capture and gesture timing
+#define BSP_TIME_USER_DECODER   (1<<1)  // RF/RC pulse decoders
+#define BSP_TIME_USER_SERVO     (1<<2)  // servo frames
+#define BSP_TIME_USER_ADC       (1<<3)  // ADC scan trigger
+#define BSP_TIME_USER_DEBUG     (1<<4)  // ISR latency, energy meter, input recorder
+#define BSP_TIME_USER_WAKE      (1<<5)  // wake-up restore time
+
+// Comparators A and B [us] (applied at the next frame start)
+#define BSP_TIME_COMPARE_A_SET(us)   TIME_COMPARE_A_SET((uint16_t)(us) >> bsp_time_shift)
+#define BSP_TIME_COMPARE_B_SET(us)   TIME_COMPARE_B_SET((uint16_t)(us) >> bsp_time_shift)
+
+
+// ****************************************************************************
+// Time base control
+// ****************************************************************************
+// Init hw-timer, time starts from zero (hw-timer is started by the first user)
+void BSP_time_init(void);
+
+// Start hw-timer for user (BSP_TIME_USER_xxx) if it is the first one
+void BSP_time_hold(uint8_t user);
+
+// Stop hw-timer if user (BSP_TIME_USER_xxx) is the last one, time stands still
+void BSP_time_release(uint8_t user);
+
+// The same for interrupt context (interrupts are already disabled)
+void BSP_time_hold_isr(uint8_t user);
+void BSP_time_release_isr(uint8_t user);
+
+// Current time [us]
+uint32_t BSP_time_us(void);
+
+// Set/clear (NULL) handler for frame start
+void BSP_time_set_frame_handler(bspTimeHandler handler);
+
+// New hw-timer clock select for new system clock, one count is (1 << shift) us
+// Interrupts must be disabled (CLOCK_SCALING_ENABLED)
+void BSP_time_clock_set(uint8_t cs, uint8_t shift);
+
+
+// Current time [us] for interrupt context (interrupts are already disabled)
+// Overflow can be pending if counter is wrapped after interrupts were disabled
+static inline uint32_t BSP_time_us_isr(void)
+{
+    uint16_t cnt;
+    uint32_t time = bsp_time_frame_us;
+
+    // Hw-timer is stopped (and gated): time stands still at frame start
+    if (!bsp_time_users) {
+        return time;
+    }
+    cnt = TIME_COUNTER() << bsp_time_shift;
+    if (TIME_OVF_FLAG_IS_UP() && (cnt < (TIME_FRAME_US / 2))) {
+        time += TIME_FRAME_US;
+    }
+    return time + cnt;
+}
+
+#endif  // TIMEBASE_ENABLED
+
+
+#endif  // BSP_TIME_H
@@ -11,24 +11,222 @@
 #include "bsp.h"
 #include "bsp_hal.h"
 #include "bsp_trace.h"
+#include "bsp_sleep.h"
+#include "bsp_events.h"
+#include "bsp_latency.h"
+#include "bsp_power.h"
+#include "bsp_time.h"
 #include "bsp_timers.h"
 
 
 // ----------------------------------------------------------------------------
 //   
+// Counters width is selected by SWTIMERS_MAX_TIME (swTimerTick_t), 
+// mode and state are packed into one byte
 typedef struct {
-   uint8_t          is_stopped; // 0 -  ; 1 -   
-   uint8_t          is_fired;   // 0 -   ; 1 -          
-   swTimerMode_t	mode;       //  (  )   
-   uint32_t     	counter;    //    
-   uint32_t     	threshold;  //     
+   uint8_t          flags;      // SWTIMER_FLAG_xxx |  (  )
+   swTimerTick_t   	counter;    //    
+   swTimerTick_t   	threshold;  //     
    swTimerHandler   handler;    //    
 } swTimer_t;
 
+#define SWTIMER_FLAG_MODE_MASK  0x03    // swTimerMode_t: bit 0 - periodic, bit 1 - async
+#define SWTIMER_FLAG_PERIODIC   SWTIMER_PERIODIC      // (1<<0)
+#define SWTIMER_FLAG_ASYNC      SWTIMER_SINGLE_ASYNC  // (1<<1)
+#define SWTIMER_FLAG_STOPPED    (1<<2)  // 0 -  ; 1 -   
+#define SWTIMER_FLAG_FIRED      (1<<3)  // 0 -   ; 1 -   
+
+
 // ----------------------------------------------------------------------------
 //   
 volatile swTimer_t swTimers[SWTIMERS_MAX];
 
+// Hw-timer clock select for current system clock (see BSP_timer_clock_resume)
+#ifdef CLOCK_SCALING_ENABLED
+static uint8_t  timer_cs = TIMER_CS;
+#else
+    #define timer_cs            TIMER_CS
+#endif
+
+
+#ifdef TIMER_TICKLESS_ENABLED
+// ----------------------------------------------------------------------------
+// Tickless mode
+// Hw-timer is programmed for the interval up to the nearest deadline instead of 
+// interrupting every TIMER_ISR_PERIOD_MSEC. Elapsed time is credited to software timers 
+// in whole ticks, the rest of tick is kept in tickless_us. 
+// If nearest deadline is farther than hw-timer can count (TIMER_MAX_COUNTS), hw-timer 
+// is stopped and the interval is counted by the sleep timer (chain).
+// No started timers - no interrupts at all.
+#define TICKLESS_TICK_US          (TIMER_ISR_PERIOD_MSEC * 1000UL)
+#define TICKLESS_HW_MAX_TICKS     ((TIMER_MAX_COUNTS * TIMER_COUNT_US) / TICKLESS_TICK_US)
+#define TICKLESS_CHAIN_STEP_MS    250UL   // sleep timer is exact for multiples of 250ms (8 x 31.25ms)
+#define TICKLESS_CHAIN_MAX_STEPS  29      // 7250ms - sleep timer uses single short interval
+
+static uint32_t tickless_us;              // time elapsed after the last credited tick [us]
+static uint8_t  tickless_counts;          // hw-timer counts programmed for current interval 
+static uint8_t  tickless_chain_steps;     // != 0 - hw-timer is stopped, sleep timer counts these steps
+static uint8_t  tickless_is_powered;      // hw-timer block is acquired (it is gated while stopped)
+static uint16_t tickless_count_us = TIMER_COUNT_US;              // hw-timer count [us] for current system clock
+static uint8_t  tickless_hw_max_ticks = TICKLESS_HW_MAX_TICKS;   // the longest hw-timer interval [ticks]
+
+// Timers are advanced right now (async handlers may start or stop timers): time is
+// already credited and the caller of timers_advance() programs the next interval
+// once, so nested calls only change timer state. Otherwise a nested call could 
+// start the chain and the outer one restart hw-timer, both counting the same time.
+static uint8_t  tickless_is_advancing;
+
+static void tickless_sync(void);
+static void tickless_credit(void);
+static void tickless_stop(void);
+static void tickless_program(uint8_t chain_allowed);
+#endif
+
+
+#ifdef USE_ISR_LATENCY
+// ----------------------------------------------------------------------------
+// Latency of hw-timer interrupt
+// Hw-timer count is too coarse (1024us in tickless mode): ISR entry is timestamped by
+// time base. Compare matches of back-to-back hw-timer intervals are exactly one interval
+// apart, so the first interrupt after hw-timer start, sync or clock change is the 
+// reference, the next ones are measured against it (latency above the reference one).
+static uint32_t latency_expected_us;      // entry time of the next ISR with the reference latency
+static uint8_t  latency_has_ref;          // reference ISR entry is taken
+#ifndef TIMER_TICKLESS_ENABLED
+static uint16_t latency_count_us = TIMER_COUNT_US;   // hw-timer count [us] for current system clock
+#endif
+
+#define LATENCY_REF_DROP()    { latency_has_ref = 0; }
+
+// ISR entry: save latency or take the reference
+static inline void timer_latency_sample(void)
+{
+    uint32_t now_us = BSP_time_us_isr();
+    
+    if (latency_has_ref) {
+        int32_t late_us = (int32_t)(now_us - latency_expected_us);
+        BSP_LATENCY_SAMPLE(BSP_LATENCY_TIMER0_COMPA, (late_us <= 0) ? 0 : ((late_us > 0xFFFF) ? 0xFFFF : (uint16_t)late_us));
+    }
+    else {
+        latency_has_ref = 1;
+        latency_expected_us = now_us;
+    }
+}
+
+// ISR exit: the next compare match is <interval_us> after the current one
+static inline void timer_latency_next(uint32_t interval_us)
+{
+    latency_expected_us += interval_us;
+}
+#else
+    #define LATENCY_REF_DROP()    {}
+#endif
+
+
+
+// ----------------------------------------------------------------------------
+// Call handler of ASYNC timer from ISR context. 
+// Handler may restart or stop any timer (state of fired timer is already updated).
+// Latency build checks run time of handler against SWTIMER_ASYNC_BUDGET_CYCLES:
+// time base count is (1 << bsp_time_shift) us, it is BSP_SYS_CLK_HZ / 1 MHz cpu
+// cycles at any system clock.
+static inline void timer_call_async(swTimerHandler handler)
+{
+    if (handler) {
+#ifdef USE_ISR_LATENCY
+        uint32_t start_us = BSP_time_us_isr();
+        
+        handler();
+        BSP_LATENCY_ASYNC(((BSP_time_us_isr() - start_us) >> bsp_time_shift) * (BSP_SYS_CLK_HZ / 1000000UL),
+                          SWTIMER_ASYNC_BUDGET_CYCLES);
+#else
+        handler();
+#endif
+    }
+}
+
+
+// ----------------------------------------------------------------------------
+// Advance all started timers by <ticks> and fire expired ones
+// Interrupts must be disabled
+static inline void timers_advance(uint16_t ticks)
+{
+    uint8_t i;
+    volatile swTimer_t * tmr_p = swTimers;
+
+#ifdef TIMER_TICKLESS_ENABLED
+    tickless_is_advancing = 1;
+#endif
+    for(i = 0; i< SWTIMERS_MAX; i++, tmr_p++){
+        // Fields are read once into locals and written back before async handler is called
+        // (handler may restart this timer)
+        uint8_t       flags = tmr_p->flags;
+        swTimerTick_t counter, threshold, left;
+        
+        if (flags & SWTIMER_FLAG_STOPPED) {
+            continue;
+        }
+        counter = tmr_p->counter;
+        threshold = tmr_p->threshold;
+        left = threshold - counter;
+        if (left > ticks) {
+            tmr_p->counter = counter + ticks;
+            continue;
+        }
+        
+        //  
+        if (flags & SWTIMER_FLAG_PERIODIC) {
+            // Ticks after deadline are counted in the next period: periodic timer
+            // does not drift (whole missed periods are dropped, handler is called once)
+            uint16_t over = ticks - left;
+            while (over >= threshold) {
+                over -= threshold;
+            }
+            tmr_p->counter = (swTimerTick_t)over;
+        }
+        else {
+            //    - 
+            flags |= SWTIMER_FLAG_STOPPED;
+            tmr_p->counter = 0;
+            tmr_p->threshold = 0;
+        } 
+        
+        // Async timer - call handler right here, sync timer - leave it for main loop
+        if (flags & SWTIMER_FLAG_ASYNC) {
+            tmr_p->flags = flags;
+            timer_call_async(tmr_p->handler);
+        }
+        else {
+            tmr_p->flags = flags | SWTIMER_FLAG_FIRED;
+            BSP_EVENT_SET_ISR(BSP_EVENT_SWTIMER);
+        }
+    }
+#ifdef TIMER_TICKLESS_ENABLED
+    tickless_is_advancing = 0;
+#endif
+}
+
+
+// ----------------------------------------------------------------------------
+// Ticks up to the nearest deadline (0 - there are no started timers)
+static swTimerTick_t timers_nearest(void)
+{
+    swTimerTick_t nearest = 0;
+    swTimerTick_t left;
+    uint8_t i;
+    volatile swTimer_t * tmr_p = swTimers;
+    
+    for(i = 0; i< SWTIMERS_MAX; i++, tmr_p++){
+        if (!(tmr_p->flags & SWTIMER_FLAG_STOPPED)){
+            left = tmr_p->threshold - tmr_p->counter;
+            if ((nearest == 0) || (left < nearest)) {
+                nearest = left;
+            }
+        }
+    }
+    return nearest;
+}
+
 
 // ----------------------------------------------------------------------------
 //  -  ,   
@@ -36,11 +234,24 @@ void BSP_timer_init(void)
 {
     uint8_t i;
     for (i = 0; i < SWTIMERS_MAX; i++) {
-        swTimers[i].is_stopped = 1; 
+        swTimers[i].flags = SWTIMER_FLAG_STOPPED; 
     }
     
+#ifdef TIMER_TICKLESS_ENABLED
+    // Hw-timer will be started with the first software timer
+    tickless_us = 0;
+    tickless_counts = 0;
+    tickless_chain_steps = 0;
+    tickless_is_powered = 0;
+    tickless_is_advancing = 0;
+    BSP_power_acquire(BSP_POWER_TIMER0);
+    TIMER_TICKLESS_INIT();
+    BSP_power_release(BSP_POWER_TIMER0);
+#else
     //   
+    BSP_power_acquire(BSP_POWER_TIMER0);
     TIMER_INIT();
+#endif
 }
 
 
@@ -54,16 +265,33 @@ void BSP_timer_start_ms(uint8_t id, uint32_t timeout_ms,
     BSP_ASSERT(id < SWTIMERS_MAX);                 // wrong timer id
     BSP_ASSERT(timeout_ms >= SWTIMERS_MIN_TIME);   // wrong timeout    
     BSP_ASSERT(timeout_ms <= SWTIMERS_MAX_TIME);   // wrong timeout    
+    
+    // Asserts are compiled out in release: timeout is clamped, it is never truncated 
+    // to swTimerTick_t and periodic timer never gets zero threshold
+    if (timeout_ms < SWTIMERS_MIN_TIME) {
+        timeout_ms = SWTIMERS_MIN_TIME;
+    }
+    else if (timeout_ms > SWTIMERS_MAX_TIME) {
+        timeout_ms = SWTIMERS_MAX_TIME;
+    }
         
     //  
-    BSP_CRITICAL(
-        swTimers[id].is_stopped = 0;
-        swTimers[id].is_fired = 0;  
+    BSP_CRITICAL_BEGIN();
+#ifdef TIMER_TICKLESS_ENABLED
+        if (!tickless_is_advancing) {
+            tickless_sync();
+        }
+#endif
+        swTimers[id].flags = (uint8_t)mode & SWTIMER_FLAG_MODE_MASK;
         swTimers[id].counter = 0;  
-        swTimers[id].threshold = timeout_ms / TIMER_ISR_PERIOD_MSEC;
+        swTimers[id].threshold = (swTimerTick_t)(timeout_ms / TIMER_ISR_PERIOD_MSEC);
         swTimers[id].handler = handler;          
-        swTimers[id].mode = mode; 
-    );
+#ifdef TIMER_TICKLESS_ENABLED
+        if (!tickless_is_advancing) {
+            tickless_program(1);
+        }
+#endif
+    BSP_CRITICAL_END();
 }
 
 
@@ -78,7 +306,7 @@ uint8_t BSP_timer_is_run(uint8_t id)
     BSP_ASSERT(id < SWTIMERS_MAX); // wrong timer id
     
     BSP_CRITICAL(
-        is_stopped = swTimers[id].is_stopped;
+        is_stopped = swTimers[id].flags & SWTIMER_FLAG_STOPPED;
     );
     
     return !(is_stopped);
@@ -96,17 +324,105 @@ uint32_t BSP_timer_stop(uint8_t id)
     BSP_ASSERT(id < SWTIMERS_MAX); // wrong timer id
             
     //  
-    BSP_CRITICAL( 
+    BSP_CRITICAL_BEGIN();
+#ifdef TIMER_TICKLESS_ENABLED
+        if (!tickless_is_advancing) {
+            tickless_sync();
+        }
+#endif
         time = swTimers[id].counter;
-        swTimers[id].is_stopped = 1;
-        swTimers[id].is_fired = 0;  
+        swTimers[id].flags = SWTIMER_FLAG_STOPPED;
         swTimers[id].counter = 0;  
         swTimers[id].threshold = 0;
-    );
+#ifdef TIMER_TICKLESS_ENABLED
+        if (!tickless_is_advancing) {
+            tickless_program(1);
+        }
+#endif
+    BSP_CRITICAL_END();
     return (time * TIMER_ISR_PERIOD_MSEC);
 }
 
 
+// ----------------------------------------------------------------------------
+// Credit time elapsed in current tickless interval to all timers right now 
+// and take the sleep timer back if it is used to count long interval.
+// Empty if tickless mode is disabled.
+void BSP_timer_sync(void)
+{
+#ifdef TIMER_TICKLESS_ENABLED
+    BSP_USE_CRITICAL();
+    BSP_CRITICAL_BEGIN();
+        if (!tickless_is_advancing) {
+            tickless_sync();
+            tickless_program(0);
+        }
+    BSP_CRITICAL_END();
+#endif
+}
+
+
+// ----------------------------------------------------------------------------
+// Time up to the nearest deadline [ms] (0 - there are no started timers)
+uint32_t BSP_timer_nearest_ms(void)
+{
+    swTimerTick_t ticks;
+    BSP_USE_CRITICAL();
+    
+    BSP_CRITICAL( ticks = timers_nearest(); );
+    return ((uint32_t)ticks * TIMER_ISR_PERIOD_MSEC);
+}
+
+
+#ifdef CLOCK_SCALING_ENABLED
+// ----------------------------------------------------------------------------
+// System clock is going to be changed: hw-timer is paused, its counter is kept
+// Sleep timer (tickless chain) is clocked asynchronously, it is not touched
+// Interrupts must be disabled until BSP_timer_clock_resume()
+void BSP_timer_clock_suspend(void)
+{
+    LATENCY_REF_DROP();
+#ifdef TIMER_TICKLESS_ENABLED
+    if (tickless_is_powered) {
+        TIMER_STOP();
+    }
+#else
+    TIMER_STOP();
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// System clock is changed: hw-timer continues with new clock select
+void BSP_timer_clock_resume(uint8_t cs, uint16_t count_us, uint8_t comparator)
+{
+    timer_cs = cs;
+#ifdef TIMER_TICKLESS_ENABLED
+    tickless_hw_max_ticks = (uint8_t)(((uint32_t)TIMER_MAX_COUNTS * count_us) / TICKLESS_TICK_US);
+    if (count_us != tickless_count_us) {
+        // Other count duration - counts are credited at old one, interval is programmed again
+        if (tickless_is_powered) {
+            tickless_credit();
+        }
+        tickless_count_us = count_us;
+        if (!tickless_chain_steps) {
+            tickless_program(1);
+        }
+    }
+    // The same count duration - interval goes on from the same counter value
+    if (tickless_is_powered && !TIMER_IS_STARTED()) {
+        TIMER_START_CS(cs);
+    }
+#else
+    TIMER_RETUNE(cs, comparator);
+#ifdef USE_ISR_LATENCY
+    latency_count_us = count_us;
+#endif
+#endif
+}
+
+#endif  // CLOCK_SCALING_ENABLED
+
+
 // ----------------------------------------------------------------------------
 //        
 //      
@@ -118,8 +434,8 @@ void BSP_timer_process(uint8_t id)
     BSP_ASSERT(id < SWTIMERS_MAX); // wrong timer id
     
     BSP_CRITICAL(
-        if (swTimers[id].is_fired) {
-            swTimers[id].is_fired = 0;
+        if (swTimers[id].flags & SWTIMER_FLAG_FIRED) {
+            swTimers[id].flags &= ~SWTIMER_FLAG_FIRED;
             is_fired = 1;
         }
     );
@@ -151,27 +467,171 @@ void BSP_timer_process_all(void)
 // 
 // ****************************************************************************
 
-ISR (TIMER_ISR_VECTOR)
-//interrupt [TIMER_ISR_VECTOR] void BSP_timer_compA_isr(void)
+#ifdef TIMER_TICKLESS_ENABLED
+
+// ----------------------------------------------------------------------------
+// Move whole ticks from tickless_us 
+// At most tickless_hw_max_ticks iterations after single hw-timer interval
+static inline uint16_t tickless_take_ticks(void)
 {
-    uint8_t i;
+    uint16_t ticks = 0;
+    while (tickless_us >= TICKLESS_TICK_US) {
+        tickless_us -= TICKLESS_TICK_US;
+        ticks++;
+    }
+    return ticks;
+}
+
+// ----------------------------------------------------------------------------
+// Credit time elapsed in current interval (from the last hw-timer interrupt)
+// Hw-timer stays stopped, or continues from zero 
+// Interrupts must be disabled
+static void tickless_sync(void)
+{
+#ifdef SLEEP_TIMER_ENABLED
+    if (tickless_chain_steps) {
+        uint16_t elapsed_ms = (uint16_t)BSP_sleep_timer_stop();
+        tickless_chain_steps = 0;
+        timers_advance(elapsed_ms / TIMER_ISR_PERIOD_MSEC);
+        tickless_us += (elapsed_ms % TIMER_ISR_PERIOD_MSEC) * 1000UL;
+        timers_advance(tickless_take_ticks());
+        return;
+    }
+#endif
+
+    if (tickless_is_powered && TIMER_IS_STARTED()) {
+        tickless_credit();
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Credit hw-timer counts of current interval, counter continues from zero 
+// Hw-timer must be powered, interrupts must be disabled
+static void tickless_credit(void)
+{
+    uint16_t counts = TIMER_COUNTER();
+    
+    TIMER_COUNTER_RESET();
+    LATENCY_REF_DROP();
+    // Compare match is pending - the whole interval is elapsed
+    if (TIMER_IRQ_FLAG_IS_UP()) {
+        TIMER_IRQ_FLAG_CLR();
+        counts += tickless_counts;
+    }
+    tickless_us += (uint32_t)counts * tickless_count_us;
+    timers_advance(tickless_take_ticks());
+}
+
+// ----------------------------------------------------------------------------
+// Stop hw-timer and gate its clock
+static void tickless_stop(void)
+{
+    if (tickless_is_powered) {
+        TIMER_STOP();
+        TIMER_IRQ_FLAG_CLR();
+        LATENCY_REF_DROP();
+        tickless_is_powered = 0;
+        BSP_power_release(BSP_POWER_TIMER0);
+    }
+}
 
-    for(i = 0; i< SWTIMERS_MAX; i++){
-        if (!swTimers[i].is_stopped){
-            swTimers[i].counter++;
-            if (swTimers[i].counter >= swTimers[i].threshold) {
-                //  
-                swTimers[i].counter = 0;
-                swTimers[i].is_fired = 1;
-                
-                //    - 
-                if (swTimers[i].mode == SWTIMER_SINGLE) {
-                    swTimers[i].is_stopped = 1;
-                    swTimers[i].threshold = 0;
-                } 
+// ----------------------------------------------------------------------------
+// Sleep timer has counted the long interval (sleep timer ISR)
+static void tickless_chain_done(void)
+{
+    uint16_t ticks = (uint16_t)tickless_chain_steps * (TICKLESS_CHAIN_STEP_MS / TIMER_ISR_PERIOD_MSEC);
+    tickless_chain_steps = 0;
+    timers_advance(ticks);
+    tickless_program(1);
+}
+
+// ----------------------------------------------------------------------------
+// Program hw-timer (or sleep timer) for the interval up to the nearest deadline
+// Must be called right after the interval start (hw-timer counter is zero),
+// the chain is already taken back (it is never counted together with hw-timer)
+// Interrupts must be disabled
+static void tickless_program(uint8_t chain_allowed)
+{
+    uint32_t ticks = timers_nearest();
+    uint32_t us;
+    uint8_t  counts;
+    
+    BSP_ASSERT(!tickless_chain_steps);   // interval is not credited
+    
+    // No started timers - stop hw-timer, phase does not matter anymore
+    if (ticks == 0) {
+        tickless_stop();
+        tickless_us = 0;
+        tickless_counts = 0;
+        return;
+    }
+    
+    if (ticks > tickless_hw_max_ticks) {
+#ifdef SLEEP_TIMER_ENABLED
+        // Too long for hw-timer - count it by sleep timer if it is free
+        // (hw-timer interval can be shorter than chain step with other clock settings)
+        // Timer2 is not taken from ambient animation
+        us = ticks * TICKLESS_TICK_US - tickless_us;
+        if (chain_allowed && (us >= TICKLESS_CHAIN_STEP_MS * 1000UL) && 
+            (!BSP_sleep_timer_is_run()) && (!BSP_ambient_is_run())) {
+            uint8_t steps = 0;
+            while ((us >= TICKLESS_CHAIN_STEP_MS * 1000UL) && (steps < TICKLESS_CHAIN_MAX_STEPS)) {
+                us -= TICKLESS_CHAIN_STEP_MS * 1000UL;
+                steps++;
             }
+            tickless_stop();
+            tickless_counts = 0;
+            tickless_chain_steps = steps;
+            BSP_sleep_timer_start_async_ms(steps * TICKLESS_CHAIN_STEP_MS, tickless_chain_done);
+            return;
         }
+#endif
+        counts = TIMER_MAX_COUNTS;
+    }
+    else {
+        // Round up: timer is never fired earlier than deadline
+        us = ticks * TICKLESS_TICK_US - tickless_us;
+        counts = (uint8_t)((us + tickless_count_us - 1) / tickless_count_us);
+    }
+    
+    if (!tickless_is_powered) {
+        tickless_is_powered = 1;
+        BSP_power_acquire(BSP_POWER_TIMER0);
+    }
+    tickless_counts = counts;
+    TIMER_TICKLESS_SET(counts);
+    if (!TIMER_IS_STARTED()) {
+        TIMER_TICKLESS_RESTART(timer_cs);
     }
-	
+}
+
+
+ISR (TIMER_ISR_VECTOR)
+{
+#ifdef USE_ISR_LATENCY
+    timer_latency_sample();
+#endif
+    tickless_us += (uint32_t)tickless_counts * tickless_count_us;
+    timers_advance(tickless_take_ticks());
+    tickless_program(1);
+#ifdef USE_ISR_LATENCY
+    timer_latency_next((uint32_t)tickless_counts * tickless_count_us);
+#endif
+}
+
+#else // TIMER_TICKLESS_ENABLED
+
+ISR (TIMER_ISR_VECTOR)
+//interrupt [TIMER_ISR_VECTOR] void BSP_timer_compA_isr(void)
+{
+#ifdef USE_ISR_LATENCY
+    timer_latency_sample();
+#endif
+    timers_advance(1);
+#ifdef USE_ISR_LATENCY
+    timer_latency_next((uint32_t)TIMER_PERIOD_COUNTS() * latency_count_us);
+#endif
     return;
-}
\ No newline at end of file
+}
+
+#endif // TIMER_TICKLESS_ENABLED
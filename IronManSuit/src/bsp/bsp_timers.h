@@ -27,7 +27,20 @@
 //      
 // M     - 1 c
 #define SWTIMERS_MIN_TIME   TIMER_ISR_PERIOD_MSEC
-#define SWTIMERS_MAX_TIME   3600000UL
+#ifndef SWTIMERS_MAX_TIME
+    #define SWTIMERS_MAX_TIME   3600000UL
+#endif
+
+// Counters are as narrow as SWTIMERS_MAX_TIME allows: 
+// 8-bit increment and compare in ISR are much cheaper than 32-bit ones on AVR 
+#define SWTIMERS_MAX_TICKS  (SWTIMERS_MAX_TIME / TIMER_ISR_PERIOD_MSEC)
+#if (SWTIMERS_MAX_TICKS <= 0xFFUL)
+    typedef uint8_t  swTimerTick_t;
+#elif (SWTIMERS_MAX_TICKS <= 0xFFFFUL)
+    typedef uint16_t swTimerTick_t;
+#else
+    typedef uint32_t swTimerTick_t;
+#endif
 
 
 // ----------------------------------------------------------------------------
@@ -35,10 +48,23 @@
 typedef enum {
     SWTIMER_SINGLE       = 0,    // ,    
     SWTIMER_PERIODIC     = 1,    // ,      
-    SWTIMER_SINGLE_ASYNC = 2,    // ,       
+    SWTIMER_SINGLE_ASYNC = 2,    // ,   
+    SWTIMER_PERIODIC_ASYNC = 3,  // ,   
 } swTimerMode_t;
 
 
+// ----------------------------------------------------------------------------
+// ASYNC timers: handler is called directly from the hw-timer ISR (interrupts disabled)
+// right after the timer is fired, so latency does not depend on the main loop.
+// Handler must be short and bounded: no _delay_xx(), no BSP_TRACE(), no waiting for flags.
+// Budget for one handler is SWTIMER_ASYNC_BUDGET_CYCLES cpu cycles, all async handlers
+// fired in the same tick together should stay well below one tick (TIMER_ISR_PERIOD_MSEC).
+// Budget is checked in USE_ISR_LATENCY build: run time of each handler is measured by
+// time base (a few cycles of measurement are included), overruns are printed with 
+// ISR latency tables (BSP_LATENCY_DUMP).
+#define SWTIMER_ASYNC_BUDGET_CYCLES  256UL
+
+
 // ----------------------------------------------------------------------------
 //  (          ) 
 typedef void (*swTimerHandler)(void);
@@ -63,6 +89,22 @@ uint8_t BSP_timer_is_run(uint8_t id);
 // :  [ms],     ( 0,     )
 uint32_t BSP_timer_stop(uint8_t id);
 
+// Credit time elapsed in current tickless interval to all timers right now and take the
+// sleep timer back if it counts long interval for software timers (TIMER_TICKLESS_ENABLED)
+void BSP_timer_sync(void);
+
+// Time up to the nearest deadline [ms] (0 - there are no started timers)
+// In tickless mode time of current interval is not credited yet: result can be longer
+// by this time (at most TICKLESS_CHAIN_MAX_STEPS * 250ms)
+uint32_t BSP_timer_nearest_ms(void);
+
+#ifdef CLOCK_SCALING_ENABLED
+// System clock change (bsp_clock.c), interrupts are disabled between these calls:
+// suspend pauses hw-timer, resume continues it with new settings (no time is lost)
+void BSP_timer_clock_suspend(void);
+void BSP_timer_clock_resume(uint8_t cs, uint16_t count_us, uint8_t comparator);
+#endif
+
 //        
 //      
 void BSP_timer_process(uint8_t id);
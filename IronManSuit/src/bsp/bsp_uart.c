@@ -14,6 +14,7 @@
 #include "bsp_hal.h"
 #include "bsp_uart.h"
 #include "bsp_sleep.h"
+#include "bsp_power.h"
 
 
 // ****************************************************************************
@@ -47,6 +48,10 @@
     static uint8_t  tx_free_space;
 #endif
 
+#if ((defined UART_TX_ENABLED) || (defined UART_RX_ENABLED))
+    static uint8_t  uart_is_enabled;   // UART block is acquired
+#endif
+
 #ifdef UART_RX_ENABLED
     static uint8_t  rx_buff[UART_RX_BUFFER_SIZE];
     static uint8_t* rx_head = rx_buff;
@@ -78,9 +83,11 @@ void BSP_uart_init(void)
     rx_free_space = UART_TX_BUFFER_SIZE - 1;
 #endif
       
-    // Set buadrate
+    // Set buadrate (UART clock is needed to access registers)
 #if ((defined UART_TX_ENABLED) || (defined UART_RX_ENABLED))            
+    BSP_power_acquire(BSP_POWER_UART);
     UART_SET_BAUD(UART_BAUD_BPS);
+    BSP_power_release(BSP_POWER_UART);
 #endif
 
     // Init UART pins, enable UART clocks, enable UART block itself, enable UART interrupts.     
@@ -88,11 +95,32 @@ void BSP_uart_init(void)
     
 }          
 
+#ifdef CLOCK_SCALING_ENABLED
+//-------------------------------------------------------------------------------
+// Baud rate for new system clock: double speed mode with given UBRR
+// TX must be flushed before (byte in shift register would be broken)
+void BSP_uart_clock_set(uint16_t ubrr)
+{
+#if ((defined UART_TX_ENABLED) || (defined UART_RX_ENABLED))
+    BSP_power_acquire(BSP_POWER_UART);
+    UART_SET_UBRR_2X(ubrr);
+    BSP_power_release(BSP_POWER_UART);
+#endif
+}
+#endif
+
 //-------------------------------------------------------------------------------
 // Init UART pins, enable UART clocks, enable UART block itself, enable UART interrupts.
 // Can be used for waking-up after sleep mode. 
 void BSP_uart_enable()
 {   
+#if ((defined UART_TX_ENABLED) || (defined UART_RX_ENABLED))
+    if (uart_is_enabled) {
+        return;
+    }
+    uart_is_enabled = 1;
+#endif
+
     // Init TX and RX pins
 #ifdef UART_TX_ENABLED 
     UART_TX_PIN_INIT();
@@ -104,7 +132,7 @@ void BSP_uart_enable()
     // Enable clock for UART
     // Enable UART block itself 
 #if ((defined UART_TX_ENABLED) || (defined UART_RX_ENABLED))
-    BSP_POWER_UART_ENABLE();            
+    BSP_power_acquire(BSP_POWER_UART);
     UART_ENABLE();
 #endif
                    
@@ -125,6 +153,13 @@ void BSP_uart_enable()
 // Can be used before enabling sleep mode. 
 void BSP_uart_disable()
 {   
+#if ((defined UART_TX_ENABLED) || (defined UART_RX_ENABLED))
+    if (!uart_is_enabled) {
+        return;
+    }
+    uart_is_enabled = 0;
+#endif
+
     // Disable interrupts and TX and RX modes
 #ifdef UART_TX_ENABLED
     UART_IRQ_TX_DISABLE();
@@ -140,7 +175,7 @@ void BSP_uart_disable()
     // Disable clock for UART  
 #if ((defined UART_TX_ENABLED) || (defined UART_RX_ENABLED))               
     UART_DISABLE();    
-    BSP_POWER_UART_DISABLE();
+    BSP_power_release(BSP_POWER_UART);
 #endif
 
  
@@ -212,11 +247,36 @@ void BSP_uart_send_no_isr(const uint8_t *data_p, uint8_t len)
     } while ( --len > 0 );
 }
 
+//-------------------------------------------------------------------------------
+// Wait until TX interrupt sends the last byte
+void BSP_uart_flush(void)
+{
+    uint8_t is_going;
+    BSP_USE_CRITICAL();
+    
+    do {
+        BSP_CRITICAL(is_going = tx_is_going);
+    } while (is_going);
+}
+
+//-------------------------------------------------------------------------------
+// Check if TX interrupt still sends bytes
+uint8_t BSP_uart_tx_is_busy(void)
+{
+    uint8_t is_going;
+    BSP_USE_CRITICAL();
+    
+    BSP_CRITICAL(is_going = tx_is_going);
+    return is_going;
+}
+
 
 #else 
     // Dummy function, if UART disabled
      void BSP_uart_send(const uint8_t * data_p, uint8_t len) {}
      void BSP_uart_send_no_isr(const uint8_t *data_p, uint8_t len) {}
+     void BSP_uart_flush(void) {}
+     uint8_t BSP_uart_tx_is_busy(void) { return 0; }
 #endif
 
 
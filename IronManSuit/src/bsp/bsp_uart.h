@@ -46,6 +46,16 @@
     // Send bytes in loop
     // TX Interrupt must be disabled  
     void BSP_uart_send_no_isr(const uint8_t *data_p, uint8_t len);
+    
+    // Wait until all enqueued bytes are sent (e.g. before BSP_uart_disable())
+    // TX Interrupt must be enabled
+    void BSP_uart_flush(void);
+
+    // Check if transmission is going (BSP_uart_flush() would wait)
+    uint8_t BSP_uart_tx_is_busy(void);
+
+    // Baud rate for new system clock (CLOCK_SCALING_ENABLED): double speed mode with given UBRR
+    void BSP_uart_clock_set(uint16_t ubrr);
 
     // If RX_CMD_END_SYMBOL was received, function fills the buffer <data> with 
     //   null-terminated string from the receive queue and returns length of 
@@ -5,10 +5,118 @@
 // ****************************************************************************
 
 #include <stdint.h> 
+#include <avr/pgmspace.h>
 #include "bsp.h"
 #include "bsp_hal.h"
 #include "bsp_trace.h"
 #include "bsp_sleep.h"
+#include "bsp_timers.h"
+#include "bsp_events.h"
+#include "bsp_uart.h"
+#include "bsp_power.h"
+#include "bsp_time.h"
+#include "bsp_pcint.h"
+#include "bsp_gpio.h"
+
+
+
+// ****************************************************************************
+// POWER-DOWN
+// ****************************************************************************
+static volatile uint8_t powerdown_is_woken;
+
+// Pin change of RF data pin only wakes MCU up
+ISR (POWERDOWN_WAKE_VECTOR)
+{
+    powerdown_is_woken = 1;
+}
+
+// ----------------------------------------------------------------------------
+// Sleep in power-down or power-save mode until pin change, restore peripherals
+// In power-save Timer2 interrupts which don't set events (ambient animation steps)
+// are served right in sleep: MCU sleeps again without restore.
+// ----------------------------------------------------------------------------
+static uint16_t power_sleep(uint8_t is_save)
+{
+    uint8_t  prr, tccr0b, tccr1b, adcsra;
+#ifdef TIMEBASE_ENABLED
+    uint32_t wake_us;
+#endif
+
+    // UART: trace output is finished (no wait if nothing is sent), then UART and its pins are off
+    BSP_uart_flush();
+    BSP_uart_disable();
+    
+    // Interrupts are disabled until SLEEP: wake-up interrupt can't be lost
+    BSP_ALL_INT_DISABLE();
+#ifdef PCINT1_ENABLED
+    BSP_pcint_pause();
+#endif
+    POWERDOWN_TIMERS_STOP(tccr0b, tccr1b);
+    POWERDOWN_ADC_STOP(adcsra);
+    powerdown_is_woken = 0;
+    POWERDOWN_WAKE_ON();
+
+    if (is_save) {
+        POWERSAVE_PRR_STOP(prr);
+        while (1) {
+            SLEEP_POWER_SAVE_MODE_SEI();
+            BSP_ALL_INT_DISABLE();
+            if (bsp_events || powerdown_is_woken) {
+                break;
+            }
+            AMBIENT_TIMER_SYNC();
+        }
+    }
+    else {
+        POWERDOWN_PRR_STOP(prr);
+        SLEEP_POWER_DOWN_MODE_SEI();
+    }
+    
+    // Wake-up: reverse order, time base runs first to measure restore time
+    BSP_ALL_INT_DISABLE();
+    POWERDOWN_PRR_RESTORE(prr);
+    POWERDOWN_TIMERS_RESTORE(tccr0b, tccr1b);
+#ifdef TIMEBASE_ENABLED
+    // Time base may have no users: it is held until restore time is taken
+    BSP_time_hold_isr(BSP_TIME_USER_WAKE);
+    wake_us = BSP_time_us_isr();
+#endif
+    POWERDOWN_WAKE_OFF();
+    POWERDOWN_ADC_RESTORE(adcsra);
+#ifdef PCINT1_ENABLED
+    // Wake-up edge was served with gated time base: it is captured again right now
+    BSP_pcint_resume();
+#endif
+    BSP_ALL_INT_ENABLE();
+    
+    BSP_uart_enable();
+    
+#ifdef TIMEBASE_ENABLED
+    wake_us = BSP_time_us() - wake_us;
+    BSP_time_release(BSP_TIME_USER_WAKE);
+    return (uint16_t)wake_us;
+#else
+    return 0;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// Sleep in power-down mode until pin change, restore peripherals
+// ----------------------------------------------------------------------------
+uint16_t BSP_power_down(void)
+{
+    return power_sleep(0);
+}
+
+// ----------------------------------------------------------------------------
+// Sleep in power-save mode until pin change or event, restore peripherals
+// ----------------------------------------------------------------------------
+uint16_t BSP_power_save(void)
+{
+    return power_sleep(1);
+}
+
 
 
 #ifdef SLEEP_TIMER_ENABLED // only if sleep timer available in HAL
@@ -20,6 +128,8 @@ typedef struct {
    volatile uint8_t  is_fired;
    volatile uint8_t  is_started_short;
    volatile uint8_t  is_fired_temp;
+   volatile uint8_t  is_async;               // 1 - handler is called from ISR
+   volatile uint16_t short_interval_ms;      // duration of short interval (0 if timer starts with long interval)
    volatile uint32_t long_intervals_cnt;     // counter for long timer's intervals
    volatile uint32_t long_intervals_thr;     // threshold to start timer with long interval
    volatile sleepTimerHandler handler;       //    
@@ -27,6 +137,26 @@ typedef struct {
    
 volatile sleepTimer_t sleepTimer; 
 
+static void ambient_stop(void);
+
+static uint8_t sleep_timer_is_powered;       // Timer2 block is acquired while hw timer counts
+
+
+// ----------------------------------------------------------------------------
+// Acquire Timer2 block when hw timer is started, release it when hw timer is stopped
+static void sleep_timer_power(uint8_t on)
+{
+    if (on != sleep_timer_is_powered) {
+        sleep_timer_is_powered = on;
+        if (on) {
+            BSP_power_acquire(BSP_POWER_TIMER2);
+        }
+        else {
+            BSP_power_release(BSP_POWER_TIMER2);
+        }
+    }
+}
+
 
 
 // ----------------------------------------------------------------------------
@@ -35,9 +165,11 @@ volatile sleepTimer_t sleepTimer;
 // ----------------------------------------------------------------------------
 void BSP_sleep_timer_init (void) 
 {                   
+    sleep_timer_power(1);
     SLEEP_TIMER_START(1); 
     // sleep timer's interrupts are still disabled here
     SLEEP_TIMER_STOP();
+    sleep_timer_power(0);
 }
 
 
@@ -45,36 +177,113 @@ void BSP_sleep_timer_init (void)
 // Start sleep timer with period in milliseconds
 // Timeout = comp_short_local  +  SLEEP_TIMER_LONG_TICK_MS * thr_long_local
 // ----------------------------------------------------------------------------
-void BSP_sleep_timer_start_ms(uint32_t timeout_ms, sleepTimerHandler handler)
+static void sleep_timer_start(uint32_t timeout_ms, sleepTimerHandler handler, uint8_t is_async)
 {
     BSP_USE_CRITICAL(); 
 
     // Calculate thresholds  
     uint32_t thr_long_local  = timeout_ms / SLEEP_TIMER_LONG_TICK_MS;  // how many long intervals in timeout_ms  
-    uint8_t short_compar  = (uint8_t)((timeout_ms - thr_long_local * SLEEP_TIMER_LONG_TICK_MS) * 1000UL / SLEEP_TIMER_TICK_US);
-        
-    BSP_TRACE("sleep timer %dms: %d x %dms + %dms", timeout_ms, thr_long_local, SLEEP_TIMER_LONG_TICK_MS, 
-                                                        (timeout_ms - thr_long_local * SLEEP_TIMER_LONG_TICK_MS));
+    uint16_t short_ms_local  = (uint16_t)(timeout_ms - thr_long_local * SLEEP_TIMER_LONG_TICK_MS);
+    uint8_t short_compar  = (uint8_t)(short_ms_local * 1000UL / SLEEP_TIMER_TICK_US);
                                                                             
-    BSP_CRITICAL(  
+    BSP_CRITICAL_BEGIN();
+        // Timer2 is taken back from ambient animation
+        ambient_stop();
+#ifdef TIMER_TICKLESS_ENABLED
+        // Sleep timer may count long interval for software timers - take it back 
+        if (!is_async) {
+            BSP_timer_sync();
+        }
+#endif
         sleepTimer.is_started = 1;
         sleepTimer.is_fired = 0;
         sleepTimer.is_started_short = (short_compar) ? 1 : 0; 
         sleepTimer.is_fired_temp = 0;                                               
+        sleepTimer.is_async = is_async;
+        sleepTimer.short_interval_ms = (short_compar) ? short_ms_local : 0;
         sleepTimer.long_intervals_cnt = 0;
         sleepTimer.long_intervals_thr = thr_long_local;
         sleepTimer.handler = handler;          
-    );
     
+        // Start timer with short interval and enable interrupts        
+        // If short interval is zero - start timer with long interval       
+        if (short_compar == 0) { 
+            short_compar = SLEEP_TIMER_LONG_COMPAR;     
+        }
+
+        sleep_timer_power(1);
+        SLEEP_TIMER_START(short_compar);   
+        SLEEP_TIMER_ISR_ENABLE(); 
+    BSP_CRITICAL_END();
+}
+
+void BSP_sleep_timer_start_ms(uint32_t timeout_ms, sleepTimerHandler handler)
+{
+#ifdef SLEEP_TIMER_DEBUG
+    uint32_t thr_long_local  = timeout_ms / SLEEP_TIMER_LONG_TICK_MS;
     
-    // Start timer with short interval and enable interrupts        
-    // If short interval is zero - start timer with long interval       
-    if (short_compar == 0) { 
-        short_compar = SLEEP_TIMER_LONG_COMPAR;     
-    }
+    BSP_TRACE("sleep timer %lums: %lu x %lums + %lums", timeout_ms, thr_long_local, SLEEP_TIMER_LONG_TICK_MS, 
+                                                        (timeout_ms - thr_long_local * SLEEP_TIMER_LONG_TICK_MS));
+#endif
+    sleep_timer_start(timeout_ms, handler, 0);
+}
 
-    SLEEP_TIMER_START(short_compar);   
-    SLEEP_TIMER_ISR_ENABLE(); 
+// ----------------------------------------------------------------------------
+// Start sleep timer, handler will be called from sleep timer ISR.
+// No trace output - can be called from ISR context.
+// ----------------------------------------------------------------------------
+void BSP_sleep_timer_start_async_ms(uint32_t timeout_ms, sleepTimerHandler handler)
+{
+    sleep_timer_start(timeout_ms, handler, 1);
+}
+
+// ----------------------------------------------------------------------------
+// Check if sleep timer is started and not fired yet
+// ----------------------------------------------------------------------------
+uint8_t BSP_sleep_timer_is_run(void)
+{
+    uint8_t is_run;
+    BSP_USE_CRITICAL();
+    BSP_CRITICAL(is_run = sleepTimer.is_started && (!sleepTimer.is_fired));
+    return is_run;
+}
+
+// ----------------------------------------------------------------------------
+// Stop sleep timer, handler will not be called
+// Returns time [ms] elapsed from start (0 if timer was not started)
+// ----------------------------------------------------------------------------
+uint32_t BSP_sleep_timer_stop(void)
+{
+    uint32_t elapsed_ms = 0;
+    BSP_USE_CRITICAL();
+    
+    BSP_CRITICAL_BEGIN();
+    if (sleepTimer.is_started) {
+        elapsed_ms = sleepTimer.long_intervals_cnt * SLEEP_TIMER_LONG_TICK_MS;
+        if (!sleepTimer.is_started_short) {
+            elapsed_ms += sleepTimer.short_interval_ms;
+        }
+        // Part of current interval
+        if (!sleepTimer.is_fired) {
+            uint8_t counts = SLEEP_TIMER_COUNTER();
+            // Compare match is not served yet (interrupts are disabled): the whole
+            // interval is elapsed, counter counts the next one
+            if (SLEEP_TIMER_IRQ_FLAG_IS_UP()) {
+                elapsed_ms += (sleepTimer.is_started_short) ? sleepTimer.short_interval_ms : SLEEP_TIMER_LONG_TICK_MS;
+                counts = SLEEP_TIMER_COUNTER();
+            }
+            elapsed_ms += (uint32_t)counts * SLEEP_TIMER_TICK_US / 1000UL;
+        }
+        
+        sleepTimer.is_started = 0;
+        sleepTimer.is_fired = 0;
+        SLEEP_TIMER_ISR_DISABLE();
+        SLEEP_TIMER_STOP();
+        sleep_timer_power(0);
+    }
+    BSP_CRITICAL_END();
+    
+    return elapsed_ms;
 }
     
 // ----------------------------------------------------------------------------
@@ -102,7 +311,9 @@ void BSP_sleep_timer_process()
         sleepTimer.is_started = 0;
         BSP_CRITICAL_END();
         
+#ifdef SLEEP_TIMER_DEBUG
         BSP_TRACE("sleep timer fired", 0);
+#endif
                           
         // Process event 
         if (sleepTimer.handler) {
@@ -115,10 +326,30 @@ void BSP_sleep_timer_process()
 }  
 
 
+// ----------------------------------------------------------------------------
+// Timer is fired
+// Async timer is finished right in ISR - call handler, nothing for BSP_sleep_timer_process()
+// Handler may restart sleep timer
+static inline void sleep_timer_fired(void)
+{
+    if (sleepTimer.is_async) {
+        sleepTimer.is_started = 0;
+        sleepTimer.is_fired = 0;
+        if (sleepTimer.handler) {
+            (sleepTimer.handler)();
+        }
+    }
+    else {
+        BSP_EVENT_SET_ISR(BSP_EVENT_SLEEP_TIMER);
+    }
+}
+
+
 // ----------------------------------------------------------------------------
 // Sleep timer interrupt - first interrupt after wakeup
 // ----------------------------------------------------------------------------
-interrupt [SLEEP_TIMER_ISR_VECTOR] void BSP_sleep_timer_compA_isr(void)
+ISR (SLEEP_TIMER_ISR_VECTOR)
+//interrupt [SLEEP_TIMER_ISR_VECTOR] void BSP_sleep_timer_compA_isr(void)
 {    
     if (sleepTimer.is_started && (!sleepTimer.is_fired)) {
         // If it was short interval
@@ -137,6 +368,8 @@ interrupt [SLEEP_TIMER_ISR_VECTOR] void BSP_sleep_timer_compA_isr(void)
             }
             else {
                 sleepTimer.is_fired = 1;
+                sleep_timer_power(0);
+                sleep_timer_fired();
             }
         }
          
@@ -152,6 +385,8 @@ interrupt [SLEEP_TIMER_ISR_VECTOR] void BSP_sleep_timer_compA_isr(void)
                 // Stop hw timer
                 SLEEP_TIMER_ISR_DISABLE();  
                 SLEEP_TIMER_STOP();
+                sleep_timer_power(0);
+                sleep_timer_fired();
             }
         }
     }
@@ -161,6 +396,133 @@ interrupt [SLEEP_TIMER_ISR_VECTOR] void BSP_sleep_timer_compA_isr(void)
 
 
 
+// ****************************************************************************
+// AMBIENT ANIMATION
+// ****************************************************************************
+// Software PWM of one LED on Timer2 frames, pulse width is stepped from table
+typedef struct {
+    volatile uint8_t  is_started;
+    volatile uint8_t  level;                 // current pulse width (0 - LED is off)
+    volatile uint8_t  index;                 // current level in table
+    volatile uint8_t  frames_cnt;            // frames of current level
+    volatile uint32_t frames;                // frames after start
+    volatile uint32_t level_sum;             // sum of pulse widths after start (LED on-time in 1/256 frame)
+    uint8_t           frames_per_step;
+    uint8_t           levels_num;
+    const uint8_t *   levels_p;              // table in flash
+} ambient_t;
+
+static ambient_t ambient;
+
+
+// ----------------------------------------------------------------------------
+// Stop animation, LED is off (sleep timer may own Timer2 after it)
+static void ambient_stop(void)
+{
+    if (ambient.is_started) {
+        ambient.is_started = 0;
+        AMBIENT_TIMER_STOP();
+        sleep_timer_power(0);
+        AMBIENT_LED_OFF();
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Start animation: levels are taken from table in flash one by one (in a loop),
+// each level lasts frames_per_step frames of AMBIENT_FRAME_HZ.
+// Long interval of software timers (tickless chain) is taken back to hw-timer.
+// Returns 0 if Timer2 is busy by sleep timer started by application.
+// ----------------------------------------------------------------------------
+uint8_t BSP_ambient_start(const uint8_t * levels_p, uint8_t levels_num, uint8_t frames_per_step)
+{
+    uint8_t is_started = 0;
+    BSP_USE_CRITICAL();
+
+    BSP_ASSERT((levels_num != 0) && (frames_per_step != 0));
+
+    BSP_CRITICAL_BEGIN();
+#ifdef TIMER_TICKLESS_ENABLED
+    // Sleep timer counts long interval for software timers - take it back,
+    // it is not chained again while animation runs
+    if (sleepTimer.is_started && sleepTimer.is_async) {
+        BSP_timer_sync();
+    }
+#endif
+    if (!sleepTimer.is_started) {
+        ambient_stop();
+        ambient.levels_p = levels_p;
+        ambient.levels_num = levels_num;
+        ambient.frames_per_step = frames_per_step;
+        ambient.index = 0;
+        ambient.frames_cnt = 0;
+        ambient.frames = 0;
+        ambient.level_sum = 0;
+        ambient.level = pgm_read_byte(&levels_p[0]);
+        ambient.is_started = 1;
+        sleep_timer_power(1);
+        AMBIENT_TIMER_START(ambient.level);
+        is_started = 1;
+    }
+    BSP_CRITICAL_END();
+
+    return is_started;
+}
+
+// ----------------------------------------------------------------------------
+void BSP_ambient_stop(void)
+{
+    BSP_USE_CRITICAL();
+    BSP_CRITICAL(ambient_stop());
+}
+
+// ----------------------------------------------------------------------------
+uint8_t BSP_ambient_is_run(void)
+{
+    return ambient.is_started;
+}
+
+// ----------------------------------------------------------------------------
+// Time of animation and LED on-time after start [ms]
+void BSP_ambient_time(uint32_t * run_ms_p, uint32_t * led_ms_p)
+{
+    uint32_t frames, level_sum;
+    BSP_USE_CRITICAL();
+
+    BSP_CRITICAL(frames = ambient.frames; level_sum = ambient.level_sum);
+
+    *run_ms_p = (frames / AMBIENT_FRAME_HZ) * 1000UL + 
+                ((frames % AMBIENT_FRAME_HZ) * 1000UL) / AMBIENT_FRAME_HZ;
+    *led_ms_p = (level_sum / (256UL * AMBIENT_FRAME_HZ)) * 1000UL + 
+                ((level_sum % (256UL * AMBIENT_FRAME_HZ)) * 1000UL) / (256UL * AMBIENT_FRAME_HZ);
+}
+
+
+// ----------------------------------------------------------------------------
+// Frame start: LED is on, the next level is set once per step
+ISR (AMBIENT_FRAME_VECTOR)
+{
+    if (ambient.level) {
+        AMBIENT_LED_ON();
+    }
+    ambient.frames++;
+    ambient.level_sum += ambient.level;
+    if (++ambient.frames_cnt >= ambient.frames_per_step) {
+        ambient.frames_cnt = 0;
+        if (++ambient.index >= ambient.levels_num) {
+            ambient.index = 0;
+        }
+        ambient.level = pgm_read_byte(&ambient.levels_p[ambient.index]);
+        AMBIENT_TIMER_SET(ambient.level);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Pulse end: LED is off
+ISR (AMBIENT_PULSE_END_VECTOR)
+{
+    AMBIENT_LED_OFF();
+}
+
 
 #endif  // SLEEP_TIMER_ENABLED
 
@@ -158,6 +158,9 @@
     #error "ERROR: Missing declaration for BSP_SYS_CLK_HZ (ADC clock)" 
 #endif
 
+// Prescaler for other system clock (clock scaling)
+#define ADC_SET_PRESCALLER_BITS(ps)  { ADCSRA = (ADCSRA & ~((1<<ADPS2)|(1<<ADPS1)|(1<<ADPS0))) | (ps); }
+
 
 //-------------------------------------------------------------------------------
 // ADMUX register: 
@@ -188,10 +191,13 @@
 // ADEN 0    - ADC Disable
 // MUX4:MUX0 - select input channel to get measure
 // ADEN 1    - ADC Enable
-#define ADC_ON(input) { ADCSRA &= ~(1<<ADEN);    \
-                        ADMUX |= (input & 0x1F); \
+#define ADC_ON(input) { ADCSRA &= ~(1<<ADEN);                       \
+                        ADC_SET_INPUT(input);                       \
 					    ADCSRA |=  (1<<ADEN);       }
 
+// Select input channel (ADC is enabled, no conversion is running)
+#define ADC_SET_INPUT(input) { ADMUX = (ADMUX & ~0x1F) | ((input) & 0x1F); }
+
 // Values of ADMUX (MUX4:MUX0) register
 #define ADC_INPUT_0     0x00
 #define ADC_INPUT_1     0x01
@@ -212,6 +218,15 @@
 // Start single convertion
 #define ADC_START()   { ADCSRA |= (1<<ADSC); }
 
+// Conversion is running
+#define ADC_IS_BUSY() (ADCSRA & (1<<ADSC))
+
+//-------------------------------------------------------------------------------
+// Auto trigger by Timer 1 overflow (ADTS2:ADTS0 110): one conversion per time base frame.
+// Overflow interrupt of time base clears the flag, so each frame is a new trigger edge.
+#define ADC_SCAN_TRIGGER_ON()   { ADCSRB = (1<<ADTS2) | (1<<ADTS1); ADCSRA |= (1<<ADATE); }
+#define ADC_SCAN_TRIGGER_OFF()  { ADCSRA &= ~(1<<ADATE); ADCSRB = 0; }
+
 //-------------------------------------------------------------------------------
 // Last measurement (8bit)
 #define ADC_RAW8_GET_VALUE(val)         { val = ADCH; } 
@@ -220,14 +235,26 @@
 // ADCL must be read first, then ADCH
 #define ADC_RAW8_GET_VALUES(val, mbit)  { mbit = ADCL; mbit = ((mbit>>6) & 0x01); val = ADCH;} 
 
+// Last measurement (10bit) and its high 8 bits (left adjusted result)
+// ADCL must be read first, then ADCH
+#define ADC_RAW10_GET_VALUES(val10, val8)  { uint8_t low_ = ADCL; val8 = ADCH; val10 = ((uint16_t)val8 << 2) | (low_ >> 6); }
+
 //-------------------------------------------------------------------------------
-// Reference
-#define BSP_ADC_REF_mV_x10   110
+// Reference: internal 1.1V (1.0..1.2V on each chip), AVcc for its calibration
+#define BSP_ADC_REF_mV       1100
+#define BSP_ADC_REF_MIN_mV   1000
+#define BSP_ADC_REF_MAX_mV   1200
+
+#define ADC_REF_INTERNAL()   { ADMUX |= (1<<REFS1) | (1<<REFS0); }
+#define ADC_REF_AVCC()       { ADMUX = (ADMUX & ~((1<<REFS1) | (1<<REFS0))) | (1<<REFS0); }
+
+// Bandgap (internal 1.1V) as input
+#define ADC_INPUT_BANDGAP    0x0E
 
-// Convert result to decased of mV
-//   mV_x10 = raw8_u16t * ref / 255 
-//   Where raw8_u16t - is raw 8-bit adc value (0..255) stroed in 16-bit variable
-#define ADC_RAW8_TO_mV_x10(raw8_u16t)  (raw8_u16t * BSP_ADC_REF_mV_x10 / 255) 
+// Convert result of <bits> width to mV: full scale is 2^bits, so it is multiply and shift
+//   mV = raw * ref_mV >> bits
+// raw * ref_mV must fit 32 bits (up to 16-bit raw)
+#define ADC_RAW_TO_mV(raw, ref_mv, bits)  ((uint16_t)(((uint32_t)(raw) * (ref_mv)) >> (bits)))
 
 
 
@@ -0,0 +1,71 @@
+// ****************************************************************************
+// Hardware access layer for ATmega328p
+// ****************************************************************************
+// System clock prescaller
+//
+// To enable clock scaling, in external file must be defined:
+//    CLOCK_SCALING_ENABLED
+//    BSP_SYS_CLK_HZ      - clock after reset (CKDIV8 fuse, internal 8 MHz RC)
+//
+// Each clock has its own settings for blocks clocked by system clock:
+//    Timer 1  - 1us per count if possible, 4us at the slowest clock
+//    Timer 0  - tickless: the longest count, not tickless: 10ms comparator
+//    UART     - double speed (U2X), UBRR for UART_BAUD_BPS
+//    ADC      - ADC clock 125 kHz
+// Busy-wait delays (_delay_ms) are calibrated for BSP_SYS_CLK_HZ only.
+//
+// ****************************************************************************
+
+#ifndef HAL_CLOCK
+#define HAL_CLOCK
+
+#include <avr/io.h>
+#include "bsp.h"
+
+
+#ifdef CLOCK_SCALING_ENABLED
+
+#if (BSP_SYS_CLK_HZ != 1000000UL)
+    #error "ERROR: Clock settings are declared for BSP_SYS_CLK_HZ 1 MHz (internal RC with CKDIV8)"
+#endif
+
+#define CLOCK_RC_HZ              8000000UL
+
+//----------------------------------------------------------------------------
+// System clock prescaller: CLKPCE is written with zero CLKPS, then CLKPS
+// alone in 4 cycles - timed sequence is written in asm. Interrupts must be disabled.
+#define CLOCK_SET_PRESCALLER(clkps)  do { __asm__ __volatile__ ("sts %[reg], %[ce]" "\n\t"                 \
+                                                                 "sts %[reg], %[ps]"                        \
+                                        : : [reg] "n" (_SFR_MEM_ADDR(CLKPR)),                               \
+                                            [ce]  "r" ((uint8_t)(1<<CLKPCE)),                               \
+                                            [ps]  "r" ((uint8_t)(clkps))); } while (0)
+
+
+//----------------------------------------------------------------------------
+// Settings for each clock (in order of bspClock_t)
+//
+//                   System          Timer 1              Timer 0 (tickless)     Timer 0 (10ms)                     UART    ADC
+//                   clock   CLKPS   CS           shift   CS                     CS                     comparator  UBRR    ADPS
+// SLOW              250k    /32     /1   4us     2       /256   1024us          /64    256us           38 (9.98ms) 12      /2
+// NORMAL            1M      /8      /1   1us     0       /1024  1024us          /64    64us            156         51      /8
+#define CLOCK_UBRR_2X(hz, bps)   ((((hz) + 4 * (bps)) / (8 * (bps))) - 1)
+
+#ifdef TIMER_TICKLESS_ENABLED
+    #define CLOCK_TIMER_SLOW     (1<<CS02),               1024, 255
+    #define CLOCK_TIMER_NORMAL   (1<<CS02) | (1<<CS00),   1024, 255
+#else
+    #define CLOCK_TIMER_SLOW     (1<<CS01) | (1<<CS00),   256,  38
+    #define CLOCK_TIMER_NORMAL   (1<<CS01) | (1<<CS00),   64,   156
+#endif
+
+#define CLOCK_SETTINGS  {                                                                                            \
+    { 5, (1<<CS10), 2, CLOCK_TIMER_SLOW,   CLOCK_UBRR_2X(250000UL,  UART_BAUD_BPS), (1<<ADPS0)                 },     \
+    { 3, (1<<CS10), 0, CLOCK_TIMER_NORMAL, CLOCK_UBRR_2X(1000000UL, UART_BAUD_BPS), (1<<ADPS1) | (1<<ADPS0)    },     \
+}
+
+// Clock after reset
+#define CLOCK_RESET_INDEX        1
+
+
+#endif // CLOCK_SCALING_ENABLED
+#endif // HAL_CLOCK
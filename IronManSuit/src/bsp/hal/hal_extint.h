@@ -6,11 +6,15 @@
 // To enable External interrupt, in external file must be defined:
 //    EXTINT0_ENABLED
 //    EXTINT1_ENABLED
+//    PCINT1_ENABLED      - pin change interrupt for PORTC
+//    RFRX_ENABLED        - INT0 on any change for OOK decoder (instead of EXTINT0_ENABLED)
+//    RCIN_ENABLED        - pin change interrupt for PORTC for RC receiver pulses (instead of PCINT1_ENABLED)
 //
 //
 // Hardware EXTINT pins for current MCU:  
 //    PD2 - int0
 //    PD3 - int1
+//    PC0..PC6 - pcint1 (PCINT8..PCINT14), any pin can be selected by mask
 // ****************************************************************************
 
 #ifndef HAL_EXTINT
@@ -29,6 +33,7 @@
 // **************************************************************************** 
 #define EXTI0_PORT    PORTD
 #define EXTI0_DDR     DDRD
+#define EXTI0_PIN     PIND
 #define EXTI0_BIT     2
 
 #define EXTI1_PORT    PORTD
@@ -71,7 +76,63 @@
 
 
 //-------------------------------------------------------------------------------
-#if (!defined(EXTINT0_ENABLED) && !defined(EXTINT1_ENABLED))
+
+#ifdef PCINT1_ENABLED
+	// Init pin change interrupt for PORTC pins selected by mask (pins must be already initialized as inputs)
+	#define PCINT1_INIT(mask)  { PCMSK1 = (mask); PCIFR = (1 << PCIF1); }
+	// Enable/disable
+	#define PCINT1_ON()     { PCICR |= (1 << PCIE1);  }
+	#define PCINT1_OFF()    { PCICR &= ~(1 << PCIE1); }
+	// Pins value
+	#define PCINT1_PINS()   (PINC)
+	// Vector name
+	#define PCINT1_ISR_VECTOR   PCINT1_vect
+#endif
+
+//-------------------------------------------------------------------------------
+
+#ifdef RCIN_ENABLED
+    #ifdef PCINT1_ENABLED
+        #error "ERROR: PCINT1 can be used either by PCINT1_ENABLED or by RCIN_ENABLED"
+    #endif
+	// Init PORTC pins selected by mask as inputs without pull-up, pin change interrupt for them
+	#define RCIN_INIT(mask)  { DDRC &= ~(mask); PORTC &= ~(mask); PCMSK1 = (mask); PCIFR = (1 << PCIF1); }
+	// Enable/disable
+	#define RCIN_ON()       { PCICR |= (1 << PCIE1);  }
+	#define RCIN_OFF()      { PCICR &= ~(1 << PCIE1); }
+	// Pins value (channel n is PCn)
+	#define RCIN_PINS()     (PINC)
+	// Vector name
+	#define RCIN_ISR_VECTOR   PCINT1_vect
+#endif
+
+
+
+//-------------------------------------------------------------------------------
+
+#ifdef RFRX_ENABLED
+    #ifdef EXTINT0_ENABLED
+        #error "ERROR: INT0 can be used either by EXTINT0_ENABLED or by RFRX_ENABLED"
+    #endif
+	// Init INT0 pin as input, interrupt on any logical change
+	#define RFRX_INIT()     { HAL_GPIO_INIT_INP_ZZ(EXTI0_PORT, EXTI0_DDR, EXTI0_BIT);                   \
+                              EICRA = (EICRA & ~((1 << ISC01)|(1 << ISC00))) | (1 << ISC00);          \
+                              EIFR = (1 << INTF0);                                                    }
+	// Enable/disable
+	#define RFRX_ON()       { EIMSK |= (1 << INT0);  }
+	#define RFRX_OFF()      { EIMSK &= ~(1 << INT0); }
+	// Clear edges which came while interrupt was disabled
+	#define RFRX_IRQ_FLAG_CLR()   { EIFR = (1 << INTF0); }
+	// Pin level
+	#define RFRX_IS_HIGH()  HAL_GPIO_IS_UP(EXTI0_PIN, EXTI0_BIT)
+	// Vector name
+	#define RFRX_ISR_VECTOR   INT0_vect
+#endif
+
+
+
+//-------------------------------------------------------------------------------
+#if (!defined(EXTINT0_ENABLED) && !defined(EXTINT1_ENABLED) && !defined(RFRX_ENABLED) && !defined(PCINT1_ENABLED) && !defined(RCIN_ENABLED))
     #warning "WARNING: All EXT INT are disabled "
 #endif 
 
@@ -26,6 +26,53 @@
 #define SLEEP_STANDBY_MODE()             { SMCR = (1<<SE) | (1<<SM2) | (1<<SM1); BSP_SLEEP(); SMCR = 0; }
 #define SLEEP_ADC_NOISE_REDUCTION_MODE() { SMCR = (1<<SE) | (1<<SM0);            BSP_SLEEP(); SMCR = 0; }
 
+// Enable interrupts and sleep: instruction after SEI is always executed before 
+// any pending interrupt, so interrupt can't come between SEI and SLEEP
+#define BSP_SEI_SLEEP()  do { __asm__ __volatile__ ("sei" "\n\t" "sleep"); } while (0)
+
+#define SLEEP_IDLE_MODE_SEI()            { SMCR = (1<<SE);                       BSP_SEI_SLEEP(); SMCR = 0; }
+#define SLEEP_ADC_NOISE_REDUCTION_MODE_SEI() { SMCR = (1<<SE) | (1<<SM0);        BSP_SEI_SLEEP(); SMCR = 0; }
+
+// Power-down with BOD disabled: BODS is written together with BODSE, then alone,
+// SLEEP must follow in 3 cycles - timed sequence is written in asm.
+#define BSP_BODS_SEI_SLEEP(mcucr)  do { __asm__ __volatile__ ("out %[reg], %[bodse]" "\n\t"              \
+                                                               "out %[reg], %[bods]"  "\n\t"              \
+                                                               "sei"                  "\n\t"              \
+                                                               "sleep"                                     \
+                                      : : [reg]   "I" (_SFR_IO_ADDR(MCUCR)),                               \
+                                          [bodse] "r" ((uint8_t)((mcucr) | (1<<BODS) | (1<<BODSE))),       \
+                                          [bods]  "r" ((uint8_t)(((mcucr) | (1<<BODS)) & ~(1<<BODSE)))); } while (0)
+
+#define SLEEP_POWER_DOWN_MODE_SEI()      { uint8_t mcucr_ = MCUCR; SMCR = (1<<SE) | (1<<SM1); BSP_BODS_SEI_SLEEP(mcucr_); SMCR = 0; }
+#define SLEEP_POWER_SAVE_MODE_SEI()      { uint8_t mcucr_ = MCUCR; SMCR = (1<<SE) | (1<<SM1) | (1<<SM0); BSP_BODS_SEI_SLEEP(mcucr_); SMCR = 0; }
+
+
+
+// **************************************************************************
+// POWER-DOWN
+// Only level interrupts and pin change interrupts wake MCU from power-down,
+// INT0 edges don't. RF data pin (PD2) is watched by pin change interrupt in sleep.
+// **************************************************************************
+#define POWERDOWN_WAKE_ON()      { PCMSK2 |= (1<<PCINT18); PCIFR = (1<<PCIF2); PCICR |= (1<<PCIE2); }
+#define POWERDOWN_WAKE_OFF()     { PCICR &= ~(1<<PCIE2); PCMSK2 &= ~(1<<PCINT18); }
+#define POWERDOWN_WAKE_VECTOR    PCINT2_vect
+
+// Timers 0 and 1 are stopped (clock select is saved), registers must be accessed before PRR gating
+#define POWERDOWN_TIMERS_STOP(tccr0b, tccr1b)     { tccr0b = TCCR0B; TCCR0B = 0;                                     \
+                                                    tccr1b = TCCR1B; TCCR1B = tccr1b & ~((1<<CS12)|(1<<CS11)|(1<<CS10)); }
+#define POWERDOWN_TIMERS_RESTORE(tccr0b, tccr1b)  { TCCR1B = tccr1b; TCCR0B = tccr0b; }
+
+// ADC is disabled (enabled ADC consumes current in power-down too)
+#define POWERDOWN_ADC_STOP(adcsra)      { adcsra = ADCSRA; ADCSRA = adcsra & ~(1<<ADEN); }
+#define POWERDOWN_ADC_RESTORE(adcsra)   { ADCSRA = adcsra; }
+
+// Power reduction register is saved and all blocks are gated
+#define POWERDOWN_PRR_STOP(prr)         { prr = PRR; PRR = 0xFF; }
+#define POWERDOWN_PRR_RESTORE(prr)      { PRR = prr; }
+
+// Power-save: the same, but Timer2 (asynchronous) keeps its state
+#define POWERSAVE_PRR_STOP(prr)         { prr = PRR; PRR = prr | (uint8_t)~(1<<PRTIM2); }
+
 
 
 // ****************************************************************************
@@ -68,6 +115,13 @@
 #define POWER_SPI_ENABLE()       {PRR &= ~(1<<PRSPI);}
 #define POWER_SPI_DISABLE()      {PRR |= (1<<PRSPI);}
 
+// Gate/ungate blocks selected by mask of PRR bits
+#define POWER_MASK_ENABLE(mask)  {PRR &= ~(mask);}
+#define POWER_MASK_DISABLE(mask) {PRR |= (mask);}
+
+// PRR bits in order of bspPowerBlock_t (bsp_power.h)
+#define POWER_BLOCK_BITS         { (1<<PRADC), (1<<PRUSART0), (1<<PRTIM0), (1<<PRTIM1), (1<<PRTIM2), (1<<PRSPI), (1<<PRTWI) }
+
 
 // **************************************************************************
 // ASYNCHRONOUS TIMER
@@ -124,17 +178,23 @@
 //	To switch to asynchronous operation: Wait for TCN2xUB, OCR2xUB, and TCR2xUB.
 //	Clear the Timer/Counter2 Interrupt Flags.
 //	Enable interrupts, if needed.
+// Prescaler is reset and counter is cleared after clock select: the first tick is
+// whole, timer is never fired earlier than programmed.
 #define SLEEP_TIMER_START(compar) {	                                                    \
 										TIMSK2 = 0;                   	        		\
 										ASSR = (1<<AS2);          						\
 										TCNT2 = 0;                						\
-										while(ASSR & TCN2UB) {}                 		\
+										while(ASSR & (1<<TCN2UB)) {}                 		\
 										TCCR2A = (1<<WGM21);     						\
-										while(ASSR & TCR2AUB) {}                		\
+										while(ASSR & (1<<TCR2AUB)) {}                		\
 										OCR2A = compar;                         		\
-										while(ASSR & OCR2AUB) {}                		\
+										while(ASSR & (1<<OCR2AUB)) {}                		\
 										TCCR2B = SLEEP_TIMER_PRESCALLER_1024;       	\
-										while(ASSR & TCR2BUB) {}                		\
+										while(ASSR & (1<<TCR2BUB)) {}                		\
+										GTCCR = (1<<PSRASY);                           	\
+										while(GTCCR & (1<<PSRASY)) {}                  	\
+										TCNT2 = 0;                						\
+										while(ASSR & (1<<TCN2UB)) {}                 		\
                                         TIFR2 = ((1<<OCF2A) | (1<<OCF2B) | (1<<TOV2)); 	\
 									}                    
                                                                                        	
@@ -144,7 +204,7 @@
 										TIMSK2 = 0;                   	        		\
 										ASSR = (1<<AS2);          						\
 										TCCR2B = 0;                         	     	\
-										while(ASSR & TCR2BUB) {}                		\
+										while(ASSR & (1<<TCR2BUB)) {}                		\
                                         TIFR2 = ((1<<OCF2A) | (1<<OCF2B) | (1<<TOV2)); 	\
 									} 
   
@@ -154,9 +214,54 @@
 #define SLEEP_TIMER_ISR_DISABLE()   {TIMSK2 = 0;}
 
 
+//----------------------------------------------------------------------------
+// Current value of counter (SLEEP_TIMER_TICK_US per count)
+#define SLEEP_TIMER_COUNTER()       (TCNT2)
+
+// Compare match is pending (counter is cleared already in CTC mode)
+#define SLEEP_TIMER_IRQ_FLAG_IS_UP()  (TIFR2 & (1<<OCF2A))
+
+
 //----------------------------------------------------------------------------
 // Vector name for comparator interrupt
-#define SLEEP_TIMER_ISR_VECTOR   TIM2_COMPA  
+#define SLEEP_TIMER_ISR_VECTOR   TIMER2_COMPA_vect  
+
+
+
+// **************************************************************************
+// AMBIENT PWM
+// Timer2 in normal mode from 32768 Hz crystal without prescaller: 128 Hz frame.
+// Overflow starts LED pulse, comparator B ends it (comparator A is used by
+// sleep timer). Both interrupts wake MCU up from power-save.
+// **************************************************************************
+#define AMBIENT_FRAME_HZ         128
+
+#define AMBIENT_TIMER_START(level)  {	                                                \
+										TIMSK2 = 0;                   	        		\
+										ASSR = (1<<AS2);          						\
+										TCNT2 = 0;                						\
+										while(ASSR & (1<<TCN2UB)) {}                 	\
+										TCCR2A = 0;                 						\
+										while(ASSR & (1<<TCR2AUB)) {}                	\
+										OCR2B = level;                         			\
+										while(ASSR & (1<<OCR2BUB)) {}                	\
+										TCCR2B = (1<<CS20);                         	\
+										while(ASSR & (1<<TCR2BUB)) {}                	\
+                                        TIFR2 = ((1<<OCF2A) | (1<<OCF2B) | (1<<TOV2)); 	\
+                                        TIMSK2 = (1<<OCIE2B) | (1<<TOIE2);              \
+									}
+
+#define AMBIENT_TIMER_STOP()        SLEEP_TIMER_STOP()
+
+// New pulse width, it is applied asynchronously (busy until the next crystal clock)
+#define AMBIENT_TIMER_SET(level)    { OCR2B = level; }
+
+// Interrupt condition is cleared only on the next crystal clock: power-save can be
+// entered again after dummy write to TCCR2A is synchronized (and OCR2B too)
+#define AMBIENT_TIMER_SYNC()        { TCCR2A = 0; while(ASSR & ((1<<TCR2AUB) | (1<<OCR2BUB))) {} }
+
+#define AMBIENT_FRAME_VECTOR     TIMER2_OVF_vect
+#define AMBIENT_PULSE_END_VECTOR TIMER2_COMPB_vect
 
 
 
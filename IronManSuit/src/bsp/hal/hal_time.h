@@ -0,0 +1,103 @@
+// ****************************************************************************
+// Hardware access layer for ATmega328p
+// ****************************************************************************
+// 16-bit Timer/Counter 1 as microseconds time base
+//
+// To enable time base, in external file must be defined:
+//    TIMEBASE_ENABLED
+//    BSP_SYS_CLK_HZ
+//
+// Timer runs in Fast PWM mode with TOP = ICR1 while time base is held, one period is
+// TIME_FRAME_US. The period is equal to servo frame, so comparators A and B
+// can be used for servo pulses without timer reconfiguration.
+//
+// ****************************************************************************
+
+#ifndef HAL_TIME
+#define HAL_TIME
+
+#include <avr/io.h>
+#include "bsp/bsp.h"
+
+
+#ifdef TIMEBASE_ENABLED
+
+//----------------------------------------------------------------------------
+// Timer clock and frame
+//----------------------------------------------------------------------------
+#define TIME_CLK_HZ          BSP_SYS_CLK_HZ
+#define TIME_FRAME_US        20000UL       // overflow period [us]
+
+#if (TIME_CLK_HZ == 1000000UL)
+    #define TIME_CS          (1<<CS10)     // 1MHz/1 = 1us
+#elif (TIME_CLK_HZ == 8000000UL)
+    #define TIME_CS          (1<<CS11)     // 8MHz/8 = 1us
+#else
+    #error "ERROR: Missing declaration for TIME_CLK_HZ (time base clock)"
+#endif
+
+
+// ----------------------------------------------------------------------------
+// Macro for full initialization, timer is left stopped
+//  TCCR1B = (1<<WGM13) | (1<<WGM12);               // stop timer
+//  TCCR1A = (1<<WGM11);                            // Fast PWM, TOP = ICR1 (with WGM13, WGM12 in TCCR1B)
+//  ICR1 = TIME_FRAME_US - 1;                       // period
+//  TIFR1 = all flags;                              // clear pending interrupts
+//  TIMSK1 = 0;                                     // overflow interrupt is on while timer runs
+#define TIME_INIT()       { TCCR1B = (1<<WGM13) | (1<<WGM12);                      \
+                            TCCR1A = (1<<WGM11);                                   \
+                            ICR1 = TIME_FRAME_US - 1;                              \
+                            TCNT1 = 0;                                             \
+                            TIFR1 = (1<<TOV1) | (1<<OCF1A) | (1<<OCF1B);           \
+                            TIMSK1 = 0; }
+
+// Start new frame from zero with given clock select, one count is (1 << shift) us
+#define TIME_RUN(cs, shift) { TCCR1B = (1<<WGM13) | (1<<WGM12);                    \
+                            ICR1 = (TIME_FRAME_US >> (shift)) - 1;                 \
+                            TCNT1 = 0;                                             \
+                            TIFR1 = (1<<TOV1);                                     \
+                            TIMSK1 |= (1<<TOIE1);                                  \
+                            TCCR1B = (1<<WGM13) | (1<<WGM12) | (cs); }
+
+// Stop timer and its overflow interrupt
+#define TIME_HALT()       { TCCR1B = (1<<WGM13) | (1<<WGM12);                      \
+                            TIMSK1 &= ~(1<<TOIE1); }
+
+
+//----------------------------------------------------------------------------
+// Time base access
+//   TIME_COUNTER()             - microseconds from the frame start
+//   TIME_OVF_FLAG_IS_UP()      - frame end is pending (interrupt is not processed yet)
+//   TIME_COMPARE_A_SET(us)     - comparator A (applied at the next frame start)
+//   TIME_COMPARE_B_SET(us)     - comparator B (applied at the next frame start)
+//   TIME_COMPARES_ON()         - enable comparators A and B interrupts
+//   TIME_COMPARES_OFF()        - disable comparators A and B interrupts
+#define TIME_COUNTER()             (TCNT1)
+#define TIME_OVF_FLAG_IS_UP()      (TIFR1 & (1<<TOV1))
+#define TIME_COMPARE_A_SET(us)     { OCR1A = (us); }
+#define TIME_COMPARE_B_SET(us)     { OCR1B = (us); }
+#define TIME_COMPARES_ON()         { TIFR1 = (1<<OCF1A) | (1<<OCF1B); TIMSK1 |= (1<<OCIE1A) | (1<<OCIE1B); }
+#define TIME_COMPARES_OFF()        { TIMSK1 &= ~((1<<OCIE1A) | (1<<OCIE1B)); }
+
+
+//----------------------------------------------------------------------------
+// New clock select for other system clock (clock scaling): one count is 
+// (1 << shift) us, frame duration is the same. Counter, TOP and comparators are
+// rescaled from old shift to new one.
+#define TIME_RETUNE(cs, from, to)  { TCCR1B = (1<<WGM13) | (1<<WGM12);                        \
+                                     ICR1 = (TIME_FRAME_US >> (to)) - 1;                      \
+                                     TCNT1 = (uint16_t)(TCNT1 << (from)) >> (to);             \
+                                     OCR1A = (uint16_t)(OCR1A << (from)) >> (to);             \
+                                     OCR1B = (uint16_t)(OCR1B << (from)) >> (to);             \
+                                     TCCR1B = (1<<WGM13) | (1<<WGM12) | (cs); }
+
+
+//----------------------------------------------------------------------------
+// Vector names
+#define TIME_OVF_VECTOR        TIMER1_OVF_vect
+#define TIME_COMPA_VECTOR      TIMER1_COMPA_vect
+#define TIME_COMPB_VECTOR      TIMER1_COMPB_vect
+
+
+#endif // TIMEBASE_ENABLED
+#endif // HAL_TIME
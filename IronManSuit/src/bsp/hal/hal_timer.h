@@ -39,7 +39,12 @@
 
 #define TIMER_CLK_HZ                    BSP_SYS_CLK_HZ
 
-#if (TIMER_CLK_HZ == 1000000UL)
+#if (defined TIMER_TICKLESS_ENABLED)
+    // Tickless mode: comparator is reprogrammed for each interval, 
+    // the slowest clock gives the longest interval (255 counts)
+    #define TIMER_PRESCALLER 1024
+    #define TIMER_COMPARATOR 255
+#elif (TIMER_CLK_HZ == 1000000UL)
     #define TIMER_PRESCALLER 64
     #define TIMER_COMPARATOR 156 
 #elif (TIMER_CLK_HZ == 8000000UL)
@@ -53,15 +58,26 @@
 // ----------------------------------------------------------------------------
 // Macro to start hw-timer with prescaller
 #if (TIMER_PRESCALLER == 1024)   
-    #define TIMER_START()  { TCCR0B = (1<<CS02) | (1<<CS00); } 
+    #define TIMER_CS       ((1<<CS02) | (1<<CS00))
 #elif (TIMER_PRESCALLER == 256) 
-    #define TIMER_START()  { TCCR0B = (1<<CS02); }
+    #define TIMER_CS       (1<<CS02)
 #elif (TIMER_PRESCALLER == 64) 
-    #define TIMER_START()  { TCCR0B = (1<<CS01) | (1<<CS00); }
+    #define TIMER_CS       ((1<<CS01) | (1<<CS00))
 #else
     #error "ERROR: Missing declaration for TIMER_PRESCALLER (HW timer prescaller value)"
 #endif  
 
+#define TIMER_START()      { TCCR0B = TIMER_CS; }
+#define TIMER_START_CS(cs) { TCCR0B = (cs); }
+
+// New clock select and comparator for other system clock (clock scaling)
+// Counter keeps the same part of period, pending compare match is kept
+#define TIMER_RETUNE(cs, comparator)  { TCCR0B = 0;                                          \
+                                        TCNT0 = (uint8_t)(((uint16_t)TCNT0 * ((comparator) + 1)) \
+                                                / ((uint16_t)OCR0A + 1));                    \
+                                        OCR0A = (comparator);                                \
+                                        TIMER_START_CS(cs); }
+
 
 // ----------------------------------------------------------------------------
 // Macro for 8-bit hw-timer full initialization and start
@@ -82,6 +98,44 @@
 							TIMER_START(); }
                                
                             
+//----------------------------------------------------------------------------
+// Current value of hw-timer counter (TIMER_PRESCALLER cpu cycles per count)
+#define TIMER_COUNTER()    (TCNT0)
+
+
+//----------------------------------------------------------------------------
+// Tickless mode control
+//   TIMER_COUNT_US             - duration of one count [us] 
+//   TIMER_MAX_COUNTS           - the longest interval [counts]
+//   TIMER_TICKLESS_INIT()      - init in CTC mode with interrupt, but do not start
+//   TIMER_TICKLESS_SET(cnt)    - next interrupt after <cnt> counts from zero (1..255)
+//   TIMER_TICKLESS_RESTART(cs) - reset counter and start with clock select
+//   TIMER_COUNTER_RESET()      - reset counter, timer keeps running
+//   TIMER_STOP()               - stop, counter is not changed
+//   TIMER_IRQ_FLAG_IS_UP()     - compare match is pending
+//   TIMER_IRQ_FLAG_CLR()       - clear pending compare match
+#define TIMER_COUNT_US             ((TIMER_PRESCALLER * 1000000UL) / TIMER_CLK_HZ)
+#define TIMER_MAX_COUNTS           255
+
+#define TIMER_TICKLESS_INIT()     { TCCR0B = 0;                                    \
+                                    TIMSK0 = 0;                                    \
+                                    TCNT0 = 0;                                     \
+                                    TCCR0A = (1<<WGM01);                           \
+                                    OCR0A = TIMER_COMPARATOR;                      \
+                                    TIFR0 = (1<<OCF0A);                            \
+                                    TIMSK0 = (1<<OCIE0A); }
+#define TIMER_TICKLESS_SET(cnt)   { OCR0A = (uint8_t)((cnt) - 1); }
+#define TIMER_TICKLESS_RESTART(cs) { TCNT0 = 0; TIMER_START_CS(cs); }
+#define TIMER_COUNTER_RESET()     { TCNT0 = 0; }
+#define TIMER_STOP()              { TCCR0B = 0; }
+#define TIMER_IS_STARTED()        (TCCR0B & ((1<<CS02) | (1<<CS01) | (1<<CS00)))
+#define TIMER_IRQ_FLAG_IS_UP()    (TIFR0 & (1<<OCF0A))
+#define TIMER_IRQ_FLAG_CLR()      { TIFR0 = (1<<OCF0A); }
+
+// Interval between compare matches [counts] (CTC mode)
+#define TIMER_PERIOD_COUNTS()     ((uint16_t)OCR0A + 1)
+
+
 //----------------------------------------------------------------------------
 // Vector name for comparator interrupt 
 #define TIMER_ISR_VECTOR   TIMER0_COMPA_vect 
@@ -96,6 +96,12 @@
 #define UBRR_VAL(bps)      ((BSP_SYS_CLK_HZ / (16 * bps)) - 1)
 #define UART_SET_BAUD(bps)   {  UBRR0L = (UBRR_VAL(bps)     ) & 0xFF;     \
                                 UBRR0H = (UBRR_VAL(bps) >> 8) & 0x0F;  }   
+
+// Double speed mode for other system clock (clock scaling): 
+// UBRR0[11..0] = (fclk / (8 * BAUD_BPS)) - 1
+#define UART_SET_UBRR_2X(ubrr)  {   UCSR0A |= (1<<U2X0);                        \
+                                    UBRR0L = (ubrr) & 0xFF;                     \
+                                    UBRR0H = ((ubrr) >> 8) & 0x0F;  }
                                            
 //-------------------------------------------------------------------------------
 // Status register UCSR0A:  
@@ -0,0 +1,137 @@
+// ****************************************************************************
+// Energy meter
+//
+// On-time of each load is kept as whole seconds and microseconds below one
+// second: update is a few additions per load, no divisions in main loop.
+// Charge is calculated from seconds only when it is requested.
+// ****************************************************************************
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+#include "bsp.h"
+#include "bsp_trace.h"
+#include "energy.h"
+
+
+#ifdef USE_ENERGY_METER
+
+#define ENERGY_US_IN_S      1000000UL
+#define ENERGY_S_IN_H       3600UL
+
+static const energy_config_t * energy_config_p;
+
+static uint32_t energy_on_s[ENERGY_LOADS_NUM];    // on-time of loads [s]
+static uint32_t energy_on_us[ENERGY_LOADS_NUM];   // the rest of on-time below one second [us]
+static uint32_t energy_last_us;                   // time of previous update
+
+// Names for output
+#define ENERGY_NAME_LEN     18
+
+static const char energy_names[ENERGY_LOADS_NUM][ENERGY_NAME_LEN] PROGMEM = { 
+    "eyes", "chest", "left", "right", "servos",
+#ifdef CLOCK_SCALING_ENABLED
+    "cpu active slow", "cpu active normal",
+    "cpu idle slow", "cpu idle normal",
+#else
+    "cpu active", "cpu idle",
+#endif
+    "cpu save" 
+};
+
+
+
+// ----------------------------------------------------------------------------
+// Add time to one load
+static void energy_add(uint8_t load, uint32_t time_s, uint32_t time_us)
+{
+    uint32_t us = energy_on_us[load] + time_us;
+
+    if (us >= ENERGY_US_IN_S) {
+        us -= ENERGY_US_IN_S;
+        time_s++;
+    }
+    energy_on_us[load] = us;
+    energy_on_s[load] += time_s;
+}
+
+
+
+// ****************************************************************************
+// Energy meter control
+// ****************************************************************************
+// Clear all counters, set currents
+void energy_init(const energy_config_t * config_p, uint32_t now_us)
+{
+    energy_config_p = config_p;
+    for (uint8_t i = 0; i < ENERGY_LOADS_NUM; ++i) {
+        energy_on_s[i] = 0;
+        energy_on_us[i] = 0;
+    }
+    energy_last_us = now_us;
+}
+
+// ----------------------------------------------------------------------------
+// Charge time after previous update to loads from mask
+// Intervals are short (main loop pass or wait for event): seconds are taken by subtraction
+void energy_update(uint16_t loads, uint32_t now_us)
+{
+    uint32_t time_us = now_us - energy_last_us;
+    uint32_t time_s = 0;
+
+    energy_last_us = now_us;
+
+    while (time_us >= ENERGY_US_IN_S) {
+        time_us -= ENERGY_US_IN_S;
+        time_s++;
+    }
+    for (uint8_t i = 0; loads; ++i, loads >>= 1) {
+        if (loads & 1) {
+            energy_add(i, time_s, time_us);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Charge time which is not counted by time base to one load
+void energy_add_ms(energy_load_t load, uint32_t time_ms)
+{
+    if (load < ENERGY_LOADS_NUM) {
+        energy_add(load, time_ms / 1000UL, (time_ms % 1000UL) * 1000UL);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Charge of one load [uAh]: whole hours and the rest are multiplied separately,
+// so product fits 32 bits for currents up to 1 A
+uint32_t energy_charge_uah(energy_load_t load)
+{
+    uint32_t current_ua;
+    uint32_t time_s;
+
+    if (load >= ENERGY_LOADS_NUM) {
+        return 0;
+    }
+    current_ua = pgm_read_dword(&energy_config_p->current_ua[load]);
+    time_s = energy_on_s[load];
+
+    return (time_s / ENERGY_S_IN_H) * current_ua + 
+           ((time_s % ENERGY_S_IN_H) * current_ua) / ENERGY_S_IN_H;
+}
+
+// ----------------------------------------------------------------------------
+// Print on-time and charge of all loads
+void energy_dump(void)
+{
+    uint32_t total_uah = 0;
+
+    for (uint8_t i = 0; i < ENERGY_LOADS_NUM; ++i) {
+        uint32_t uah = energy_charge_uah(i);
+        
+        total_uah += uah;
+        BSP_TRACE("Energy %S: %lu s, %lu.%03lu mAh", energy_names[i], energy_on_s[i], uah / 1000UL, uah % 1000UL);
+    }
+    BSP_TRACE("Energy total: %lu.%03lu mAh", total_uah / 1000UL, total_uah % 1000UL);
+}
+
+#endif  // USE_ENERGY_METER
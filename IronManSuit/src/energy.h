@@ -0,0 +1,80 @@
+// ****************************************************************************
+// Energy meter
+//
+// To enable meter, in external file must be defined:
+//    USE_ENERGY_METER
+//
+// Charge of each load is estimated from its on-time weighted by its current.
+// Loads are suit LEDs, servos power and CPU residency (active, idle, power-save).
+// With CLOCK_SCALING_ENABLED active and idle time is kept per system clock.
+// Main loop reports state of loads (bit mask) at the end of each interval,
+// the whole interval is charged by this state. Time of power-save is added
+// separately (time base is stopped in sleep). Power-down is not counted: time
+// is not measured there and current is about 1 uA.
+// ****************************************************************************
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include <stdint.h>
+#include "bsp.h"
+#include "bsp_clock.h"
+
+
+// ****************************************************************************
+// Loads
+// ****************************************************************************
+// CPU active and idle loads have one bucket per system clock (bspClock_t order)
+#ifdef CLOCK_SCALING_ENABLED
+    #define ENERGY_CPU_CLOCKS   BSP_CLOCKS_NUM
+#else
+    #define ENERGY_CPU_CLOCKS   1
+#endif
+
+typedef enum {
+    ENERGY_LOAD_EYES,       // LED0
+    ENERGY_LOAD_CHEST,      // LED1 (and ambient animation in power-save)
+    ENERGY_LOAD_LEFT,       // LED2
+    ENERGY_LOAD_RIGHT,      // LED3
+    ENERGY_LOAD_SERVOS,     // LED4 - servos power
+    ENERGY_LOAD_CPU_ACTIVE, // main loop is running
+    ENERGY_LOAD_CPU_IDLE = ENERGY_LOAD_CPU_ACTIVE + ENERGY_CPU_CLOCKS,  // main loop waits for event in IDLE mode
+    ENERGY_LOAD_CPU_SAVE = ENERGY_LOAD_CPU_IDLE + ENERGY_CPU_CLOCKS,    // power-save mode
+    ENERGY_LOADS_NUM
+} energy_load_t;
+
+// Bucket of CPU state (ENERGY_LOAD_CPU_ACTIVE or ENERGY_LOAD_CPU_IDLE) at system clock <clock>
+#define ENERGY_LOAD_CPU(state, clock)   ((state) + (clock))
+
+#define ENERGY_LOAD_MASK(load)  (1U << (load))
+
+
+// Currents of loads [uA], up to 1 A each. Config is placed in program memory (PROGMEM).
+typedef struct {
+    uint32_t  current_ua[ENERGY_LOADS_NUM];
+} energy_config_t;
+
+
+#ifdef USE_ENERGY_METER
+
+// ****************************************************************************
+// Energy meter control
+// ****************************************************************************
+// Clear all counters, set currents (config is in PROGMEM)
+void energy_init(const energy_config_t * config_p, uint32_t now_us);
+
+// Charge time after previous update to loads from mask (ENERGY_LOAD_MASK)
+void energy_update(uint16_t loads, uint32_t now_us);
+
+// Charge time which is not counted by time base (e.g. power-save) to one load
+void energy_add_ms(energy_load_t load, uint32_t time_ms);
+
+// Charge of one load [uAh]
+uint32_t energy_charge_uah(energy_load_t load);
+
+// Print on-time and charge [mAh] of all loads to trace UART
+void energy_dump(void);
+
+#endif  // USE_ENERGY_METER
+
+
+#endif // ENERGY_H
@@ -0,0 +1,296 @@
+// ****************************************************************************
+// Buttons gesture recognizer
+//
+// Each button has its own small state machine. Transitions are taken from
+// one table in flash: (state, edge) -> (next state, action). Each state has
+// its own timeout (hold, clicks gap, repeat), expired timeout is one more edge
+// for the table. Chord is checked before the table: press of idle button
+// while another one is just pressed.
+//
+// RF receiver noise is filtered here too: press is accepted only if it is
+// stable for glitch time, after noise the button is quiet for refractory time.
+// Noise edges do not reach the table at all.
+// ****************************************************************************
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+#include "gesture.h"
+
+
+// ****************************************************************************
+// Button states and edges
+// ****************************************************************************
+enum {
+    ST_IDLE,            // released, no clicks
+    ST_PENDING,         // pressed first time, not stable yet
+    ST_DOWN_FIRST,      // pressed first time and stable (hold or chord may follow)
+    ST_UP,              // released after click, next click is waited during gap
+    ST_DOWN_NEXT,       // pressed again during gap
+    ST_HOLD,            // held longer than hold time
+    ST_CHORD,           // pressed together with another button, wait release
+    ST_NUM
+};
+
+enum {
+    EDGE_PRESS,
+    EDGE_RELEASE,
+    EDGE_GLITCH,        // release shortly after press (noise)
+    EDGE_TIMEOUT,       // state timeout is expired
+    EDGE_NUM
+};
+
+// Actions
+enum {
+    ACT_NONE,
+    ACT_START,          // first press: clear clicks, save press time
+    ACT_PRESS,          // next press: save press time
+    ACT_CLICK,          // count click, report at once if it is the last possible one
+    ACT_CLICKS,         // report clicks
+    ACT_HOLD,           // report hold
+    ACT_REPEAT,         // report hold repeat
+    ACT_HOLD_END,       // report hold end
+    ACT_NOISE           // press was noise: start refractory time
+};
+
+
+// ----------------------------------------------------------------------------
+// Transitions table: next state in low nibble, action in high nibble
+#define TR(state, act)   ((uint8_t)((state) | ((act) << 4)))
+
+static const uint8_t gesture_table[ST_NUM][EDGE_NUM] PROGMEM = {
+    //                   PRESS                         RELEASE                       GLITCH                        TIMEOUT
+    [ST_IDLE]       = { TR(ST_PENDING, ACT_START),    TR(ST_IDLE, ACT_NONE),        TR(ST_IDLE, ACT_NONE),        TR(ST_IDLE, ACT_NONE)      },
+    [ST_PENDING]    = { TR(ST_PENDING, ACT_NONE),     TR(ST_UP, ACT_CLICK),         TR(ST_IDLE, ACT_NOISE),       TR(ST_DOWN_FIRST, ACT_NONE)},
+    [ST_DOWN_FIRST] = { TR(ST_DOWN_FIRST, ACT_NONE),  TR(ST_UP, ACT_CLICK),         TR(ST_IDLE, ACT_NOISE),       TR(ST_HOLD, ACT_HOLD)      },
+    [ST_UP]         = { TR(ST_DOWN_NEXT, ACT_PRESS),  TR(ST_UP, ACT_NONE),          TR(ST_UP, ACT_NONE),          TR(ST_IDLE, ACT_CLICKS)    },
+    [ST_DOWN_NEXT]  = { TR(ST_DOWN_NEXT, ACT_NONE),   TR(ST_UP, ACT_CLICK),         TR(ST_UP, ACT_NOISE),         TR(ST_HOLD, ACT_HOLD)      },
+    [ST_HOLD]       = { TR(ST_HOLD, ACT_NONE),        TR(ST_IDLE, ACT_HOLD_END),    TR(ST_IDLE, ACT_HOLD_END),    TR(ST_HOLD, ACT_REPEAT)    },
+    [ST_CHORD]      = { TR(ST_CHORD, ACT_NONE),       TR(ST_IDLE, ACT_NONE),        TR(ST_IDLE, ACT_NONE),        TR(ST_CHORD, ACT_NONE)     },
+};
+
+
+// ****************************************************************************
+// Recognizer state
+// ****************************************************************************
+typedef struct {
+    uint8_t   state;
+    uint8_t   clicks;        // clicks counted in current sequence
+    uint32_t  press_us;      // the last press time
+    uint32_t  deadline_us;   // timeout of current state (if state has it)
+    uint32_t  quiet_us;      // presses are ignored until this time (refractory after noise)
+} gesture_button_t;
+
+static uint16_t gesture_noise_cnt;   // noise presses (saturated)
+
+static gesture_button_t         gesture_buttons[GESTURE_BUTTONS_NUM];
+static const gesture_config_t * gesture_config_p;
+
+// Queue of recognized gestures
+#define GESTURE_QUEUE_MASK  (GESTURE_QUEUE_SIZE - 1)
+static gesture_event_t  gesture_queue[GESTURE_QUEUE_SIZE];
+static uint8_t          gesture_head;
+static uint8_t          gesture_tail;
+
+
+
+// ----------------------------------------------------------------------------
+// Timeout of the state [ms], 0 - state has no timeout
+static uint16_t gesture_state_timeout_ms(uint8_t state)
+{
+    switch (state) {
+        case ST_PENDING:    return gesture_config_p->glitch_ms;
+        case ST_DOWN_FIRST:
+        case ST_DOWN_NEXT:  return gesture_config_p->hold_ms;
+        case ST_UP:         return gesture_config_p->gap_ms;
+        case ST_HOLD:       return gesture_config_p->repeat_ms;
+        default:            return 0;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Put gesture to queue, the newest one is lost if queue is full
+static void gesture_put(uint8_t buttons, gesture_type_t type)
+{
+    uint8_t next = (gesture_head + 1) & GESTURE_QUEUE_MASK;
+
+    if (next != gesture_tail) {
+        gesture_queue[gesture_head].buttons = buttons;
+        gesture_queue[gesture_head].type = type;
+        gesture_head = next;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// One table step for one button
+static void gesture_step(uint8_t button, uint8_t edge, uint32_t time_us)
+{
+    gesture_button_t * btn_p = &gesture_buttons[button];
+    uint8_t tr = pgm_read_byte(&gesture_table[btn_p->state][edge]);
+    uint8_t next = tr & 0x0F;
+    uint8_t mask = (1 << button);
+
+    switch (tr >> 4) {
+        case ACT_START:
+            btn_p->clicks = 0;
+            btn_p->press_us = time_us;
+            break;
+        case ACT_PRESS:
+            btn_p->press_us = time_us;
+            break;
+        case ACT_CLICK:
+            if (++btn_p->clicks >= GESTURE_CLICKS_MAX) {
+                gesture_put(mask, GESTURE_CLICK + GESTURE_CLICKS_MAX - 1);
+                next = ST_IDLE;
+            }
+            break;
+        case ACT_CLICKS:
+            gesture_put(mask, GESTURE_CLICK + btn_p->clicks - 1);
+            break;
+        case ACT_HOLD:
+            gesture_put(mask, GESTURE_HOLD);
+            break;
+        case ACT_REPEAT:
+            gesture_put(mask, GESTURE_HOLD_REPEAT);
+            break;
+        case ACT_HOLD_END:
+            gesture_put(mask, GESTURE_HOLD_END);
+            break;
+        case ACT_NOISE:
+            btn_p->quiet_us = time_us + (uint32_t)gesture_config_p->refractory_ms * 1000UL;
+            if (gesture_noise_cnt != 0xFFFF) gesture_noise_cnt++;
+            break;
+        default:
+            break;
+    }
+
+    // Hold time is counted from press (not from press validation)
+    if ((next == ST_DOWN_FIRST) || (next == ST_DOWN_NEXT)) {
+        time_us = btn_p->press_us;
+    }
+    btn_p->state = next;
+    btn_p->deadline_us = time_us + (uint32_t)gesture_state_timeout_ms(next) * 1000UL;
+}
+
+
+
+// ****************************************************************************
+// Gesture recognizer control
+// ****************************************************************************
+// Reset all buttons, set thresholds
+void gesture_init(const gesture_config_t * config_p)
+{
+    gesture_config_p = config_p;
+    for (uint8_t i = 0; i < GESTURE_BUTTONS_NUM; ++i) {
+        gesture_buttons[i].state = ST_IDLE;
+        gesture_buttons[i].clicks = 0;
+        gesture_buttons[i].quiet_us = 0;
+    }
+    gesture_noise_cnt = 0;
+    gesture_head = 0;
+    gesture_tail = 0;
+}
+
+// ----------------------------------------------------------------------------
+// Process button edge
+void gesture_edge(uint8_t button, uint8_t is_pressed, uint32_t time_us)
+{
+    gesture_button_t * btn_p;
+    uint8_t edge;
+
+    if (button >= GESTURE_BUTTONS_NUM) {
+        return;
+    }
+    btn_p = &gesture_buttons[button];
+
+    if (is_pressed) {
+        // Refractory time after noise - ignore press (and its release in idle state)
+        if ((int32_t)(time_us - btn_p->quiet_us) < 0) {
+            return;
+        }
+        // Chord: idle button is pressed shortly after another one
+        if (btn_p->state == ST_IDLE) {
+            for (uint8_t i = 0; i < GESTURE_BUTTONS_NUM; ++i) {
+                if (((gesture_buttons[i].state == ST_PENDING) || (gesture_buttons[i].state == ST_DOWN_FIRST)) &&
+                    ((time_us - gesture_buttons[i].press_us) < (uint32_t)gesture_config_p->chord_ms * 1000UL)) {
+                    gesture_buttons[i].state = ST_CHORD;
+                    btn_p->state = ST_CHORD;
+                    gesture_put((1 << i) | (1 << button), GESTURE_CHORD);
+                    return;
+                }
+            }
+        }
+        edge = EDGE_PRESS;
+    }
+    else if ((time_us - btn_p->press_us) < (uint32_t)gesture_config_p->glitch_ms * 1000UL) {
+        edge = EDGE_GLITCH;
+    }
+    else {
+        edge = EDGE_RELEASE;
+    }
+
+    gesture_step(button, edge, time_us);
+}
+
+// ----------------------------------------------------------------------------
+// Process timeouts which are expired at this time
+// Timeout is processed at its deadline time (not at current time), so repeats do not drift
+void gesture_timeout(uint32_t time_us)
+{
+    for (uint8_t i = 0; i < GESTURE_BUTTONS_NUM; ++i) {
+        gesture_button_t * btn_p = &gesture_buttons[i];
+
+        // Next state timeout can be expired too (e.g. press validation and hold), 
+        // the rest is processed at the next call
+        for (uint8_t n = 0; n < 2; ++n) {
+            if ((gesture_state_timeout_ms(btn_p->state) == 0) ||
+                ((int32_t)(time_us - btn_p->deadline_us) < 0)) {
+                break;
+            }
+            gesture_step(i, EDGE_TIMEOUT, btn_p->deadline_us);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Time left to the nearest timeout [us], 0 - no timeouts are waited
+uint32_t gesture_next_timeout_us(uint32_t time_us)
+{
+    uint32_t nearest = 0;
+
+    for (uint8_t i = 0; i < GESTURE_BUTTONS_NUM; ++i) {
+        gesture_button_t * btn_p = &gesture_buttons[i];
+        int32_t left;
+
+        if (gesture_state_timeout_ms(btn_p->state) == 0) {
+            continue;
+        }
+        left = (int32_t)(btn_p->deadline_us - time_us);
+        if (left <= 0) {
+            return 1;   // already expired
+        }
+        if ((nearest == 0) || ((uint32_t)left < nearest)) {
+            nearest = left;
+        }
+    }
+    return nearest;
+}
+
+// ----------------------------------------------------------------------------
+// Number of presses rejected as noise
+uint16_t gesture_noise(void)
+{
+    return gesture_noise_cnt;
+}
+
+// ----------------------------------------------------------------------------
+// Get the oldest recognized gesture
+uint8_t gesture_get(gesture_event_t * event_p)
+{
+    if (gesture_tail == gesture_head) {
+        return 0;
+    }
+    *event_p = gesture_queue[gesture_tail];
+    gesture_tail = (gesture_tail + 1) & GESTURE_QUEUE_MASK;
+    return 1;
+}
@@ -0,0 +1,78 @@
+// ****************************************************************************
+// Buttons gesture recognizer
+//
+// Classify timestamped press/release edges: clicks (single, double, triple),
+// hold with repeat and two-button chords. Short presses (RF noise) are rejected.
+// ****************************************************************************
+#ifndef GESTURE_H
+#define GESTURE_H
+
+#include <stdint.h>
+
+
+// ****************************************************************************
+// Gesture settings
+// ****************************************************************************
+#define GESTURE_BUTTONS_NUM     4   // buttons 0..3
+#define GESTURE_CLICKS_MAX      3   // triple click is reported without waiting for the gap
+#define GESTURE_QUEUE_SIZE      4   // recognized gestures waiting to be processed (power of 2)
+
+
+// ****************************************************************************
+// Gestures
+// ****************************************************************************
+typedef enum {
+    GESTURE_NONE,
+    GESTURE_CLICK,          // single click (reported after the gap)
+    GESTURE_DOUBLE_CLICK,
+    GESTURE_TRIPLE_CLICK,
+    GESTURE_HOLD,           // pressed longer than hold time (button is still pressed)
+    GESTURE_HOLD_REPEAT,    // every repeat period while button is held
+    GESTURE_HOLD_END,       // button is released after hold
+    GESTURE_CHORD,          // two buttons are pressed together
+    GESTURE_TYPES_NUM
+} gesture_type_t;
+
+
+// Recognized gesture
+typedef struct {
+    uint8_t          buttons;     // mask of buttons (bit n - button n), two bits for chord
+    gesture_type_t   type;
+} gesture_event_t;
+
+
+// Thresholds [ms]
+typedef struct {
+    uint16_t  glitch_ms;     // press must be stable this time to be accepted, shorter one is noise
+    uint16_t  gap_ms;        // the longest release between clicks of double/triple click
+    uint16_t  hold_ms;       // press longer than this is a hold
+    uint16_t  repeat_ms;     // hold repeat period
+    uint16_t  chord_ms;      // the longest delay between presses of chord buttons
+    uint16_t  refractory_ms; // presses are ignored after noise
+} gesture_config_t;
+
+
+
+// ****************************************************************************
+// Gesture recognizer control
+// ****************************************************************************
+// Reset all buttons, set thresholds (config must exist while recognizer is used)
+void gesture_init(const gesture_config_t * config_p);
+
+// Process button edge. Bounded time: one table lookup and chord check.
+void gesture_edge(uint8_t button, uint8_t is_pressed, uint32_t time_us);
+
+// Process timeouts which are expired at this time (holds, clicks gap)
+void gesture_timeout(uint32_t time_us);
+
+// Time left to the nearest timeout [us], 0 - no timeouts are waited
+uint32_t gesture_next_timeout_us(uint32_t time_us);
+
+// Number of presses rejected as noise (saturated)
+uint16_t gesture_noise(void);
+
+// Get the oldest recognized gesture. Returns 0 if there are no gestures.
+uint8_t gesture_get(gesture_event_t * event_p);
+
+
+#endif // GESTURE_H
@@ -14,9 +14,21 @@
 #include "bsp.h"
 #include "bsp_trace.h"
 #include "bsp_gpio.h"
+#include "bsp_buttons.h"
 #include "bsp_timers.h"
 #include "bsp_sleep.h"
+#include "bsp_power.h"
 #include "bsp_extint.h"
+#include "bsp_pcint.h"
+#include "bsp_rfrx.h"
+#include "bsp_rcin.h"
+#include "bsp_time.h"
+#include "bsp_events.h"
+#include "bsp_latency.h"
+#include "bsp_clock.h"
+#include "bsp_battery.h"
+#include "bsp_adc.h"
+#include "energy.h"
 #include "suitcontrol.h"
 
 
@@ -24,14 +36,11 @@
 
 int main(void)
 {
-    // Disable clocks for blocks which will be never used
-    POWER_ALL_DISABLE();
-    POWER_UART_ENABLE();
-//    POWER_ADC_ENABLE();
-    POWER_TIMER0_ENABLE();
-    POWER_TIMER1_ENABLE();
+    // Gate clocks of all blocks, drivers acquire blocks they use
+    BSP_power_init();
 
     BSP_BTNS_INIT();
+    BSP_buttons_init();
     BSP_LEDS_INIT();
     BSP_LEDS_OFF();
 
@@ -45,9 +54,30 @@ int main(void)
 	SUIT_LEDS_OFF();
 
 
+    BSP_sleep_timer_init();
     BSP_timer_init(); 
-    BSP_extint_init(0, true);
-    BSP_extint_enable(0);
+    BSP_time_init();
+#if defined(USE_ISR_LATENCY) || defined(USE_ENERGY_METER) || defined(USE_INPUT_RECORDER)
+    // Latency and energy are measured all the time, recorded gaps between gestures
+    // must not be shortened by stopped time base
+    BSP_time_hold(BSP_TIME_USER_DEBUG);
+#endif
+#ifdef USE_ENERGY_METER
+    initEnergy();
+#endif
+#ifdef RFRX_ENABLED
+    BSP_rfrx_init();
+    BSP_rfrx_enable();
+#endif
+#ifdef PCINT1_ENABLED
+    BSP_pcint_init(BSP_BTNS_PORT_MASK);
+    BSP_pcint_enable();
+#endif
+#ifdef RCIN_ENABLED
+    BSP_rcin_init(SUIT_RC_CHANNELS_MASK);
+    BSP_rcin_enable();
+#endif
+    initButtons();
     BSP_uart_init();
     BSP_uart_enable();
     
@@ -55,24 +85,85 @@ int main(void)
 
     BSP_TRACE("\r\n\r\nIRON MAN SUIT", 0);
     BSP_TRACE("Compiled: %s, %s", __DATE__, __TIME__);
+
+#ifdef SUIT_ADC_FACTORY_CAL
+    checkAdcCalibration();
+#endif
+
+#ifdef BATTERY_ENABLED
+    BSP_battery_init();
+    checkBattery();
+    BSP_timer_start_ms(TMR_BATTERY, SUIT_BATTERY_PERIOD_MS, SWTIMER_PERIODIC, checkBattery);
+#endif
+#ifdef ADC_SCAN_ENABLED
+    {
+        static const uint8_t adc_scan_channels[] = ADC_SCAN_CHANNELS;
+        BSP_adc_init();     // after battery monitor init: init stops ADC
+        BSP_adc_scan_start(adc_scan_channels, sizeof(adc_scan_channels));
+    }
+#endif
+#ifdef USE_ISR_LATENCY
+    BSP_timer_start_ms(TMR_LATENCY_DUMP, 10000, SWTIMER_PERIODIC, __latency_dump);
+#endif
     
   
 	while (1) 
     {
-           
-         // Process software timers
-         BSP_timer_process_all();
-
-         // Process buttons
-         checkPressed();
-         processButtonEvent();
+        // All work is triggered by interrupts: take pending events at once
+        uint8_t events = BSP_event_take();
+
+        // Process software timers
+        if (events & BSP_EVENT_SWTIMER) {
+            BSP_timer_process_all();
+        }
+        if (events & BSP_EVENT_SLEEP_TIMER) {
+            BSP_sleep_timer_process();
+        }
+
+        // Process buttons
+#ifdef PCINT1_ENABLED
+        if (events & BSP_EVENT_PCINT) {
+            checkButtons();
+        }
+#endif
+#ifdef RCIN_ENABLED
+        // Process RC receiver channels
+        if (events & BSP_EVENT_RCIN) {
+            checkRcInput();
+        }
+#endif
+#ifdef RFRX_ENABLED
+        // Process RF remote codes
+        if (events & BSP_EVENT_RFRX) {
+            checkRemote();
+        }
+#endif
+        processButtonEvent();
                           
-         // Process effects 
-         processEffects();
+        // Process effects 
+        processEffects();
          
-         // Sleep
-         //processSleep(); 
-
+        // Sleep
+        processSleep(); 
+
+        // Wait in IDLE mode for the next event
+#ifdef USE_ENERGY_METER
+        processEnergy(ENERGY_LOAD_CPU_ACTIVE);
+#endif
+#ifdef CLOCK_SCALING_ENABLED
+        processClock();
+#endif
+        BSP_event_wait();
+#ifdef USE_ENERGY_METER
+        processEnergy(ENERGY_LOAD_CPU_IDLE);
+#endif
+#ifdef CLOCK_SCALING_ENABLED
+        // Busy-wait delays are calibrated for BSP_SYS_CLK_HZ: clock is restored only if
+        // there is work (interrupts which only count time do not change the clock)
+        if (bsp_events) {
+            BSP_clock_set(BSP_CLOCK_NORMAL);
+        }
+#endif
     }
 	
 	return 0;
@@ -0,0 +1,128 @@
+// ****************************************************************************
+// Input recorder
+//
+// Replay walks the ring from the oldest event to the newest one. Only edges
+// are replayed: gestures are recognized again and can be compared with
+// recorded ones in the dump.
+// ****************************************************************************
+
+#include <stdint.h>
+
+#include "bsp.h"
+#include "bsp_trace.h"
+#include "recorder.h"
+
+
+#ifdef USE_INPUT_RECORDER
+
+#if ((RECORDER_SIZE & (RECORDER_SIZE - 1)) != 0)
+    #error "ERROR: RECORDER_SIZE must be power of 2"
+#endif
+#define RECORDER_MASK   (RECORDER_SIZE - 1)
+
+recorder_event_t  recorder_ring[RECORDER_SIZE];
+uint8_t           recorder_head;
+uint8_t           recorder_replaying;
+
+static uint8_t    recorder_replay_idx;     // next event to replay
+static uint8_t    recorder_replay_left;    // events left to check
+static uint32_t   recorder_replay_shift_us; // recorded time + shift = replay time
+
+
+
+// ----------------------------------------------------------------------------
+// Skip events which are not edges, returns 0 if there are no more edges
+static uint8_t recorder_replay_skip(void)
+{
+    while (recorder_replay_left) {
+        uint8_t type = recorder_ring[recorder_replay_idx].type;
+        
+        if ((type == RECORDER_PRESS) || (type == RECORDER_RELEASE)) {
+            return 1;
+        }
+        recorder_replay_idx = (recorder_replay_idx + 1) & RECORDER_MASK;
+        recorder_replay_left--;
+    }
+    recorder_replaying = 0;
+    return 0;
+}
+
+
+
+// ****************************************************************************
+// Recorder control
+// ****************************************************************************
+// Print all recorded events (the oldest first)
+void recorder_dump(void)
+{
+    uint8_t idx = recorder_head;
+    
+    BSP_TRACE("Input recorder: %d events", RECORDER_SIZE);
+    for (uint8_t i = 0; i < RECORDER_SIZE; ++i) {
+        recorder_event_t * ev_p = &recorder_ring[idx];
+        
+        switch (ev_p->type) {
+            case RECORDER_PRESS:
+                BSP_TRACE("%lu press %d", ev_p->time_us, ev_p->data);
+                break;
+            case RECORDER_RELEASE:
+                BSP_TRACE("%lu release %d", ev_p->time_us, ev_p->data);
+                break;
+            case RECORDER_GESTURE:
+                BSP_TRACE("%lu gesture %d buttons 0x%02X", ev_p->time_us, ev_p->data >> 4, ev_p->data & 0x0F);
+                break;
+            default:
+                break;
+        }
+        idx = (idx + 1) & RECORDER_MASK;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Start replay of recorded edges
+void recorder_replay_start(uint32_t now_us)
+{
+    recorder_replay_idx = recorder_head;
+    recorder_replay_left = RECORDER_SIZE;
+    recorder_replaying = 1;
+    
+    if (recorder_replay_skip()) {
+        recorder_replay_shift_us = now_us + RECORDER_REPLAY_DELAY_MS * 1000UL - recorder_ring[recorder_replay_idx].time_us;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Get the next replayed edge which is due at this time
+uint8_t recorder_replay_get(uint32_t now_us, recorder_event_t * event_p)
+{
+    uint32_t time_us;
+    
+    if (!recorder_replay_skip()) {
+        return 0;
+    }
+    time_us = recorder_ring[recorder_replay_idx].time_us + recorder_replay_shift_us;
+    if ((int32_t)(now_us - time_us) < 0) {
+        return 0;
+    }
+    
+    *event_p = recorder_ring[recorder_replay_idx];
+    event_p->time_us = time_us;
+    recorder_replay_idx = (recorder_replay_idx + 1) & RECORDER_MASK;
+    recorder_replay_left--;
+    return 1;
+}
+
+// ----------------------------------------------------------------------------
+// Time left to the next replayed edge
+uint32_t recorder_replay_next_us(uint32_t now_us)
+{
+    int32_t left;
+    
+    if (!recorder_replay_skip()) {
+        return 0;
+    }
+    left = (int32_t)(recorder_ring[recorder_replay_idx].time_us + recorder_replay_shift_us - now_us);
+    return (left > 0) ? (uint32_t)left : 0;
+}
+
+#endif  // USE_INPUT_RECORDER
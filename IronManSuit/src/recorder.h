@@ -0,0 +1,99 @@
+// ****************************************************************************
+// Input recorder
+//
+// To enable recorder, in external file must be defined:
+//    USE_INPUT_RECORDER
+//
+// RAM ring of the last input events: timestamped buttons edges (from any
+// source) and recognized gestures. The oldest events are overwritten.
+// Ring can be dumped to trace UART, and recorded edges can be replayed
+// through gesture recognizer with the same relative timestamps.
+//
+// Timestamps come from time base, which stands still without users. Recorder
+// build holds it all the time (BSP_TIME_USER_DEBUG), so gaps between gestures
+// are kept. Time still stands still in power-down and power-save sleep: gap
+// which includes sleep is recorded shorter. It is still longer than any gesture
+// timeout (suit sleeps only when recognizer is idle), so replayed gestures 
+// before and after sleep are not merged.
+// ****************************************************************************
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdint.h>
+#include "bsp.h"
+
+
+// ****************************************************************************
+// Recorder settings
+// ****************************************************************************
+#define RECORDER_SIZE               32      // events in ring (power of 2)
+#define RECORDER_REPLAY_DELAY_MS    1000    // the first replayed edge is delayed from replay start
+
+
+// Event types
+enum {
+    RECORDER_EMPTY,         // slot is not used yet
+    RECORDER_PRESS,         // data - button
+    RECORDER_RELEASE,       // data - button
+    RECORDER_GESTURE,       // data - gesture type (high nibble), buttons mask (low nibble)
+};
+
+typedef struct {
+    uint32_t  time_us;
+    uint8_t   type;
+    uint8_t   data;
+} recorder_event_t;
+
+
+// ****************************************************************************
+// RECORDER_PUT(type, data, time_us)  - save one event (nothing is saved while replay is running)
+// ****************************************************************************
+#ifdef USE_INPUT_RECORDER
+
+    extern recorder_event_t  recorder_ring[RECORDER_SIZE];
+    extern uint8_t           recorder_head;
+    extern uint8_t           recorder_replaying;
+
+    // Inline: one store of event and index increment
+    static inline void __recorder_put(uint8_t type, uint8_t data, uint32_t time_us)
+    {
+        recorder_event_t * ev_p;
+
+        if (recorder_replaying) {
+            return;
+        }
+        ev_p = &recorder_ring[recorder_head];
+        ev_p->time_us = time_us;
+        ev_p->type = type;
+        ev_p->data = data;
+        recorder_head = (recorder_head + 1) & (RECORDER_SIZE - 1);
+    }
+
+    #define RECORDER_PUT(type, data, time_us)   __recorder_put((type), (data), (time_us))
+
+
+    // ************************************************************************
+    // Recorder control
+    // ************************************************************************
+    // Print all recorded events to trace UART (the oldest first)
+    void recorder_dump(void);
+
+    // Start replay of recorded edges. Recording is stopped until replay is finished.
+    void recorder_replay_start(uint32_t now_us);
+
+    // Get the next replayed edge which is due at this time (timestamp is shifted to replay time).
+    // Returns 0 if the next edge is not due yet or replay is finished.
+    uint8_t recorder_replay_get(uint32_t now_us, recorder_event_t * event_p);
+
+    // Time left to the next replayed edge [us]
+    uint32_t recorder_replay_next_us(uint32_t now_us);
+
+    // Replay is running
+    #define recorder_is_replaying()     (recorder_replaying)
+
+#else
+    #define RECORDER_PUT(type, data, time_us)   {}  // empty
+#endif
+
+
+#endif // RECORDER_H
@@ -0,0 +1,147 @@
+// ****************************************************************************
+// Learned RF remotes
+//
+// Entry is one 32-bit word: code in low 24 bits, button in high byte.
+// EEPROM keeps the array sorted by code too: loading is a block read and one
+// pass which skips broken entries. Saving writes only changed bytes.
+// ****************************************************************************
+
+#include <stdint.h>
+#include <avr/eeprom.h>
+
+#include "bsp.h"
+#include "gesture.h"
+#include "remote.h"
+
+
+#ifdef RFRX_ENABLED
+
+
+#define REMOTE_CODE_MASK        0x00FFFFFFUL
+#define REMOTE_ENTRY(code, btn) (((code) & REMOTE_CODE_MASK) | ((uint32_t)(btn) << 24))
+#define REMOTE_ENTRY_CODE(e)    ((e) & REMOTE_CODE_MASK)
+#define REMOTE_ENTRY_BUTTON(e)  ((uint8_t)((e) >> 24))
+
+
+// ****************************************************************************
+// Table
+// ****************************************************************************
+typedef struct {
+    uint8_t   count;
+    uint32_t  entries[REMOTE_CODES_MAX];
+} remote_table_t;
+
+static remote_table_t remote_eeprom EEMEM;   // erased EEPROM: count is 0xFF
+static remote_table_t remote_table;          // RAM mirror, sorted by code
+
+
+
+// ----------------------------------------------------------------------------
+// Binary search of code. Returns index of code or index where it must be inserted.
+static uint8_t remote_search(uint32_t code, uint8_t * is_found_p)
+{
+    uint8_t lo = 0;
+    uint8_t hi = remote_table.count;
+
+    while (lo < hi) {
+        uint8_t mid = (lo + hi) >> 1;
+        uint32_t mid_code = REMOTE_ENTRY_CODE(remote_table.entries[mid]);
+
+        if (mid_code == code) {
+            *is_found_p = 1;
+            return mid;
+        }
+        if (mid_code < code) lo = mid + 1;
+        else                 hi = mid;
+    }
+    *is_found_p = 0;
+    return lo;
+}
+
+// ----------------------------------------------------------------------------
+// Save RAM table (only changed bytes are written)
+static void remote_save(void)
+{
+    eeprom_update_block(remote_table.entries, remote_eeprom.entries, remote_table.count * sizeof(uint32_t));
+    eeprom_update_byte(&remote_eeprom.count, remote_table.count);
+}
+
+
+
+// ****************************************************************************
+// Remotes table control
+// ****************************************************************************
+// Load table from EEPROM
+void remote_init(void)
+{
+    uint8_t count = eeprom_read_byte(&remote_eeprom.count);
+    uint8_t n = 0;
+
+    if (count > REMOTE_CODES_MAX) {
+        count = 0;
+    }
+    eeprom_read_block(remote_table.entries, remote_eeprom.entries, count * sizeof(uint32_t));
+
+    // Keep only valid entries in ascending order
+    for (uint8_t i = 0; i < count; ++i) {
+        uint32_t entry = remote_table.entries[i];
+
+        if ((REMOTE_ENTRY_BUTTON(entry) < GESTURE_BUTTONS_NUM) &&
+            ((n == 0) || (REMOTE_ENTRY_CODE(entry) > REMOTE_ENTRY_CODE(remote_table.entries[n - 1])))) {
+            remote_table.entries[n++] = entry;
+        }
+    }
+    remote_table.count = n;
+}
+
+// ----------------------------------------------------------------------------
+// Find button bound to code
+uint8_t remote_find(uint32_t code)
+{
+    uint8_t is_found;
+    uint8_t i = remote_search(code & REMOTE_CODE_MASK, &is_found);
+
+    return is_found ? REMOTE_ENTRY_BUTTON(remote_table.entries[i]) : REMOTE_NOT_FOUND;
+}
+
+// ----------------------------------------------------------------------------
+// Bind code to button and save table
+uint8_t remote_learn(uint32_t code, uint8_t button)
+{
+    uint8_t is_found;
+    uint8_t i;
+
+    code &= REMOTE_CODE_MASK;
+    i = remote_search(code, &is_found);
+
+    if (!is_found) {
+        if (remote_table.count >= REMOTE_CODES_MAX) {
+            return 0;
+        }
+        for (uint8_t j = remote_table.count; j > i; --j) {
+            remote_table.entries[j] = remote_table.entries[j - 1];
+        }
+        remote_table.count++;
+    }
+    remote_table.entries[i] = REMOTE_ENTRY(code, button);
+
+    remote_save();
+    return 1;
+}
+
+// ----------------------------------------------------------------------------
+// Forget all codes and save table
+void remote_forget_all(void)
+{
+    remote_table.count = 0;
+    remote_save();
+}
+
+// ----------------------------------------------------------------------------
+// Number of learned codes
+uint8_t remote_count(void)
+{
+    return remote_table.count;
+}
+
+#endif  // RFRX_ENABLED
@@ -0,0 +1,42 @@
+// ****************************************************************************
+// Learned RF remotes
+//
+// Table of remote codes bound to buttons. Table is stored in EEPROM and
+// mirrored to RAM at start as array sorted by code, so received code is
+// found by binary search (3 compares for 8 codes).
+// ****************************************************************************
+#ifndef REMOTE_H
+#define REMOTE_H
+
+#include <stdint.h>
+
+
+// ****************************************************************************
+// Remotes settings
+// ****************************************************************************
+#define REMOTE_CODES_MAX        8       // learned codes (e.g. two 4-button remotes)
+#define REMOTE_NOT_FOUND        0xFF    // code is not learned
+
+
+
+// ****************************************************************************
+// Remotes table control
+// ****************************************************************************
+// Load table from EEPROM (erased or broken table is empty)
+void remote_init(void);
+
+// Find button bound to code. Returns REMOTE_NOT_FOUND if code is not learned.
+uint8_t remote_find(uint32_t code);
+
+// Bind code to button (code which is already learned is rebound) and save table.
+// Returns 0 if table is full.
+uint8_t remote_learn(uint32_t code, uint8_t button);
+
+// Forget all codes and save table
+void remote_forget_all(void);
+
+// Number of learned codes
+uint8_t remote_count(void);
+
+
+#endif // REMOTE_H
@@ -5,14 +5,30 @@
 // ****************************************************************************
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <util/atomic.h>
+#include <avr/pgmspace.h>
 
 #include "bsp.h"
 #include "bsp_gpio.h"
+#include "bsp_buttons.h"
+#include "bsp_pcint.h"
+#include "bsp_rfrx.h"
+#include "bsp_rcin.h"
+#include "bsp_time.h"
 #include "bsp_sleep.h"
+#include "bsp_adc.h"
+#include "bsp_battery.h"
 #include "bsp_timers.h"
 #include "bsp_trace.h"
+#include "bsp_latency.h"
+#include "bsp_clock.h"
+#include "bsp_uart.h"
+#include "gesture.h"
+#include "remote.h"
+#include "recorder.h"
+#include "energy.h"
 #include "suitcontrol.h" 
 
 
@@ -21,195 +37,636 @@
 // ****************************************************************************
 uint8_t i_can_sleep = 1;
 
+// Arc reactor pulse: gamma-corrected raised cosine, never completely dark
+static const uint8_t ambient_pulse[] PROGMEM = {
+      3,   3,   3,   3,   3,   3,   4,   5,   7,   9,  12,  16,  22,  29,  37,  47,
+     58,  70,  84,  99, 115, 131, 148, 165, 181, 196, 211, 223, 234, 243, 250, 254,
+    255, 254, 250, 243, 234, 223, 211, 196, 181, 165, 148, 131, 115,  99,  84,  70,
+     58,  47,  37,  29,  22,  16,  12,   9,   7,   5,   4,   3,   3,   3,   3,   3,
+};
+static uint8_t ambient_is_on;
+
 void processSleep()
 {
+#ifdef SUIT_SLEEP_DEBUG
+    uint16_t ready_us;
+#endif
+    
     if (!i_can_sleep)
         return;
     
-    _delay_ms(100);
-    BSP_POWER_SAVE_MODE();
+    // Gesture is not recognized yet, servos are powered
+    if (BSP_timer_is_run(TMR_GESTURE) || BSP_LED4_IS_ON())
+        return;
+#ifdef USE_INPUT_RECORDER
+    if (recorder_is_replaying())
+        return;
+#endif
+    
+    // Ambient animation needs power-save (Timer2 runs), it is impossible if application sleep timer is busy
+    if (ambient_is_on && BSP_ambient_start(ambient_pulse, sizeof(ambient_pulse), SUIT_AMBIENT_STEP_FRAMES)) {
+#ifdef SUIT_SLEEP_DEBUG
+        BSP_TRACE("Power-save", 0);
+        ready_us = BSP_power_save();
+#else
+        BSP_power_save();
+#endif
+        BSP_ambient_stop();
+#ifdef USE_ENERGY_METER
+        {
+            // Time base is stopped in power-save: time is taken from animation frames
+            uint32_t run_ms, led_ms;
+            BSP_ambient_time(&run_ms, &led_ms);
+            energy_add_ms(ENERGY_LOAD_CPU_SAVE, run_ms);
+            energy_add_ms(ENERGY_LOAD_CHEST, led_ms);
+        }
+#endif
+    }
+    else {
+#ifdef SUIT_SLEEP_DEBUG
+        BSP_TRACE("Power-down", 0);
+        ready_us = BSP_power_down();
+#else
+        BSP_power_down();
+#endif
+    }
+#ifdef SUIT_SLEEP_DEBUG
+    BSP_TRACE("Wake-up: ready in %u us", ready_us);
+#endif
+}
+
+#ifdef BATTERY_ENABLED
+// Called when battery timer (TMR_BATTERY) is fired
+// Timer is paused in sleep: the first measurement after wake-up is up to one period late
+void checkBattery()
+{
+    uint16_t mv = BSP_battery_measure();
+    
+    if (mv < SUIT_BATTERY_LOW_MV) {
+        BSP_TRACE("Battery is low: %u mV", mv);
+    }
+    else {
+        BSP_TRACE("Battery %u mV", mv);
+    }
+}
+#endif
+
+#ifdef SUIT_ADC_FACTORY_CAL
+// Called once at power-up, before the first battery measurement.
+// Calibration overwrites EEPROM: it is never bound to a gesture, button must be
+// held from power-up for SUIT_ADC_CAL_HOLD_MS while supply is SUIT_ADC_CAL_VCC_MV.
+void checkAdcCalibration()
+{
+    uint16_t ref_mv;
+    
+    for (uint16_t i = 0; i < SUIT_ADC_CAL_HOLD_MS / 10; ++i) {
+        uint8_t port = BTNS_PIN;
+        if (!(BSP_BTNS_TO_MASK(port) & BSP_BTN_MASK(SUIT_ADC_CAL_BUTTON))) {
+            return;
+        }
+        _delay_ms(10);
+    }
+    
+    ref_mv = BSP_adc_calibrate(SUIT_ADC_CAL_VCC_MV);
+    if (ref_mv == 0) {
+        BSP_TRACE("ADC reference is out of range, not saved", 0);
+        return;
+    }
+    BSP_TRACE("ADC reference %u mV is saved", ref_mv);
+    
+    // Confirmation: all suit LEDs blink once
+    SUIT_LEDS_ON();
+    _delay_ms(500);
+    SUIT_LEDS_OFF();
 }
+#endif
+
+#ifdef USE_ENERGY_METER
+static const energy_config_t energy_config PROGMEM = {
+    .current_ua = {
+        [ENERGY_LOAD_EYES]       = SUIT_ENERGY_EYES_UA,
+        [ENERGY_LOAD_CHEST]      = SUIT_ENERGY_CHEST_UA,
+        [ENERGY_LOAD_LEFT]       = SUIT_ENERGY_HAND_UA,
+        [ENERGY_LOAD_RIGHT]      = SUIT_ENERGY_HAND_UA,
+        [ENERGY_LOAD_SERVOS]     = SUIT_ENERGY_SERVOS_UA,
+#ifdef CLOCK_SCALING_ENABLED
+        [ENERGY_LOAD_CPU(ENERGY_LOAD_CPU_ACTIVE, BSP_CLOCK_SLOW)]   = SUIT_ENERGY_CPU_ACTIVE_SLOW_UA,
+        [ENERGY_LOAD_CPU(ENERGY_LOAD_CPU_ACTIVE, BSP_CLOCK_NORMAL)] = SUIT_ENERGY_CPU_ACTIVE_UA,
+        [ENERGY_LOAD_CPU(ENERGY_LOAD_CPU_IDLE, BSP_CLOCK_SLOW)]     = SUIT_ENERGY_CPU_IDLE_SLOW_UA,
+        [ENERGY_LOAD_CPU(ENERGY_LOAD_CPU_IDLE, BSP_CLOCK_NORMAL)]   = SUIT_ENERGY_CPU_IDLE_UA,
+#else
+        [ENERGY_LOAD_CPU_ACTIVE] = SUIT_ENERGY_CPU_ACTIVE_UA,
+        [ENERGY_LOAD_CPU_IDLE]   = SUIT_ENERGY_CPU_IDLE_UA,
+#endif
+        [ENERGY_LOAD_CPU_SAVE]   = SUIT_ENERGY_CPU_SAVE_UA,
+    }
+};
+
+void initEnergy()
+{
+    energy_init(&energy_config, BSP_time_us());
+}
+
+// Loads are sampled at the end of interval: LEDs fading during main loop pass
+// are charged as if they were switched at once. Clock is switched only between
+// intervals (processClock and after the wait), so current clock is the clock of interval.
+void processEnergy(uint8_t cpu_load)
+{
+#ifdef CLOCK_SCALING_ENABLED
+    uint16_t loads = ENERGY_LOAD_MASK(ENERGY_LOAD_CPU(cpu_load, BSP_clock_get()));
+#else
+    uint16_t loads = ENERGY_LOAD_MASK(cpu_load);
+#endif
+    
+    if (BSP_LED0_IS_ON()) loads |= ENERGY_LOAD_MASK(ENERGY_LOAD_EYES);
+    if (BSP_LED1_IS_ON()) loads |= ENERGY_LOAD_MASK(ENERGY_LOAD_CHEST);
+    if (BSP_LED2_IS_ON()) loads |= ENERGY_LOAD_MASK(ENERGY_LOAD_LEFT);
+    if (BSP_LED3_IS_ON()) loads |= ENERGY_LOAD_MASK(ENERGY_LOAD_RIGHT);
+    if (BSP_LED4_IS_ON()) loads |= ENERGY_LOAD_MASK(ENERGY_LOAD_SERVOS);
+    energy_update(loads, BSP_time_us());
+}
+#endif
+
+#ifdef CLOCK_SCALING_ENABLED
+void processClock()
+{
+    // Servo pulses are ended in compare interrupt, gesture timing is short
+    if (BSP_LED4_IS_ON() || BSP_timer_is_run(TMR_GESTURE)) {
+        BSP_clock_set(BSP_CLOCK_NORMAL);
+        return;
+    }
+#if defined(RFRX_ENABLED) || defined(RCIN_ENABLED)
+    // Pulse widths are measured in edge interrupts, slow clock adds jitter
+    BSP_clock_set(BSP_CLOCK_NORMAL);
+#else
+    uint32_t nearest_ms;
+    
+    // Clock is not changed while trace is sent: TX interrupt wakes the loop,
+    // clock is selected again on the next pass
+    if (BSP_uart_tx_is_busy()) {
+        return;
+    }
+    // Only buttons and software timers are waited: slow clock pays back for long wait only
+    nearest_ms = BSP_timer_nearest_ms();
+    if ((nearest_ms == 0) || (nearest_ms >= SUIT_CLOCK_SLOW_IDLE_MS)) {
+        BSP_clock_set(BSP_CLOCK_SLOW);
+    }
+    else {
+        BSP_clock_set(BSP_CLOCK_NORMAL);
+    }
+#endif
+}
+#endif
 
 
 
 // ****************************************************************************
-// Button state
+// Failsafe
 // ****************************************************************************
-typedef enum {
-    BTN_NO_EVENT,      // 
-    BTN_WAIT_RELEASE,  // button was pressed but was not released yet
-    BTN_SHORT_CLICK,   // click is waiting to be processed
-    BTN_LONG_CLICK     // long click is waiting to be processed
-} button_event_t;
+// Link is alive: valid frame is received
+#if defined(RFRX_ENABLED) || defined(RCIN_ENABLED)
+static void failsafe_link_alive(void);
+#endif
+#ifdef RFRX_ENABLED
+// Remote button is released: link is not monitored until the next press
+static void failsafe_link_idle(void);
+#endif
 
 
-typedef struct button_struct_s {
-    bool             is_pressed;  // physical state
-    button_event_t   event;       // event to be processed
-    uint16_t         counter;     // counter for  
-} button_struct_t;
-
 
+// ****************************************************************************
+// Gestures
+// ****************************************************************************
 // Buttons:
 // 0 - helmet
 // 1 - eyes/chest
 // 2 - left
 // 3 - right
-static button_struct_t buttons[4];
+static const gesture_config_t gesture_config = {
+    .glitch_ms = SUIT_GESTURE_GLITCH_MS,
+    .gap_ms    = SUIT_GESTURE_GAP_MS,
+    .hold_ms   = SUIT_GESTURE_HOLD_MS,
+    .repeat_ms = SUIT_GESTURE_REPEAT_MS,
+    .chord_ms  = SUIT_GESTURE_CHORD_MS,
+    .refractory_ms = SUIT_GESTURE_REFRACTORY_MS,
+};
 
 
 
 // ****************************************************************************
-// Events
+// Actions
 // ****************************************************************************
-bool helmet_move;   // Open/close
+typedef enum {
+    SUIT_ACTION_NONE,           // gesture is not used
+    SUIT_ACTION_HELMET_TOGGLE,  // helmet open/close
+    SUIT_ACTION_LED_TOGGLE,     // toggle LED <arg> with fading
+    SUIT_ACTION_LEDS_ON,        // all suit LEDs on
+    SUIT_ACTION_LEDS_OFF,       // all suit LEDs off
+    SUIT_ACTION_REMOTE_LEARN,   // bind the next received RF codes to buttons 0..3 (again - cancel)
+    SUIT_ACTION_REMOTE_FORGET,  // forget all RF codes
+    SUIT_ACTION_RECORDER_DUMP,  // print recorded input events
+    SUIT_ACTION_RECORDER_REPLAY,// replay recorded input edges
+    SUIT_ACTION_AMBIENT_TOGGLE, // arc reactor pulse in sleep on/off
+    SUIT_ACTION_ENERGY_DUMP,    // print charge of each load
+} suit_action_type_t;
+
+typedef struct {
+    uint8_t  type;      // suit_action_type_t
+    uint8_t  arg;       // LED number for SUIT_ACTION_LED_TOGGLE
+} suit_action_t;
+
+
+// ----------------------------------------------------------------------------
+// Dispatch tables in flash: gestures of single buttons by button number and gesture,
+// chords by buttons mask (chord is the only gesture of two buttons). One lookup per 
+// gesture, 96 bytes instead of 256 of the full (buttons mask x gesture) table.
+// Remapping of buttons does not need any code changes.
+#define ACTION(type, arg)   { (type), (arg) }
+#define CHORD(n, m)         (BSP_BTN_MASK(n) | BSP_BTN_MASK(m))
+
+static const suit_action_t suit_button_actions[GESTURE_BUTTONS_NUM][GESTURE_TYPES_NUM] PROGMEM = {
+    // Helmet
+    [0] = {
+        [GESTURE_CLICK]         = ACTION(SUIT_ACTION_HELMET_TOGGLE,   0),
+        [GESTURE_HOLD]          = ACTION(SUIT_ACTION_HELMET_TOGGLE,   0),
+        [GESTURE_DOUBLE_CLICK]  = ACTION(SUIT_ACTION_ENERGY_DUMP,     0),
+    },
+    // Eyes/Chest
+    [1] = {
+        [GESTURE_CLICK]         = ACTION(SUIT_ACTION_LED_TOGGLE,      0),
+        [GESTURE_DOUBLE_CLICK]  = ACTION(SUIT_ACTION_LED_TOGGLE,      1),
+        [GESTURE_TRIPLE_CLICK]  = ACTION(SUIT_ACTION_LEDS_ON,         0),
+        [GESTURE_HOLD]          = ACTION(SUIT_ACTION_LED_TOGGLE,      1),
+    },
+    // Left hand
+    [2] = {
+        [GESTURE_CLICK]         = ACTION(SUIT_ACTION_LED_TOGGLE,      2),
+        [GESTURE_HOLD]          = ACTION(SUIT_ACTION_LED_TOGGLE,      2),
+    },
+    // Right hand
+    [3] = {
+        [GESTURE_CLICK]         = ACTION(SUIT_ACTION_LED_TOGGLE,      3),
+        [GESTURE_HOLD]          = ACTION(SUIT_ACTION_LED_TOGGLE,      3),
+    },
+};
 
-bool eyes_toggle;  // Just toggle eye leds 
-bool chest_toggle;  // Just toggle chest leds 
+static const suit_action_t suit_chord_actions[1 << GESTURE_BUTTONS_NUM] PROGMEM = {
+    [CHORD(2, 3)]   = ACTION(SUIT_ACTION_LEDS_OFF,        0),   // both hands
+    [CHORD(0, 1)]   = ACTION(SUIT_ACTION_REMOTE_LEARN,    0),   // helmet and eyes/chest
+    [CHORD(0, 2)]   = ACTION(SUIT_ACTION_REMOTE_FORGET,   0),   // helmet and left hand
+    [CHORD(1, 2)]   = ACTION(SUIT_ACTION_RECORDER_DUMP,   0),   // eyes/chest and left hand
+    [CHORD(1, 3)]   = ACTION(SUIT_ACTION_RECORDER_REPLAY, 0),   // eyes/chest and right hand
+    [CHORD(0, 3)]   = ACTION(SUIT_ACTION_AMBIENT_TOGGLE,  0),   // helmet and right hand
+};
 
-bool left_toggle;   // Just toggle left hand LED
-bool left_effect;   // Toggle left hand LED with effect
+// Action bound to gesture of buttons (SUIT_ACTION_NONE if gesture is not used)
+static void suit_action_find(uint8_t buttons, uint8_t gesture, suit_action_t * action_p)
+{
+    const suit_action_t * src_p = NULL;
+    
+    if (gesture == GESTURE_CHORD) {
+        if (buttons < (1 << GESTURE_BUTTONS_NUM)) {
+            src_p = &suit_chord_actions[buttons];
+        }
+    }
+    else if (gesture < GESTURE_TYPES_NUM) {
+        // Button number of single bit mask (GESTURE_BUTTONS_NUM steps at most)
+        for (uint8_t n = 0; n < GESTURE_BUTTONS_NUM; ++n) {
+            if (buttons == BSP_BTN_MASK(n)) {
+                src_p = &suit_button_actions[n][gesture];
+                break;
+            }
+        }
+    }
+    
+    if (src_p) {
+        memcpy_P(action_p, src_p, sizeof(*action_p));
+    }
+    else {
+        action_p->type = SUIT_ACTION_NONE;
+        action_p->arg = 0;
+    }
+}
 
-bool right_toggle;   // Just toggle right hand LED
-bool right_effect;   // Toggle right hand LED with effect
 
 
+// ****************************************************************************
+// Read and process buttons
+// ****************************************************************************
+// Inactivity (forward declaration)
+static void idle_restart(void);
 
 
 
+#if defined(PCINT1_ENABLED) || defined(RFRX_ENABLED)
+static uint8_t idle_input(uint8_t button, uint8_t is_pressed);
 
-// ****************************************************************************
-// Read and process buttons
-// ****************************************************************************
-// INTERRUPT CONTEXT
-// Flag for ISR context - One of buttons was pressed 
-static volatile bool button_pressed_isr;
+// Button edge from any input (buttons, RF remote) is recorded and passed to gesture recognizer.
+// Inputs are ignored while recorded edges are replayed.
+static void input_edge(uint8_t button, uint8_t is_pressed, uint32_t time_us)
+{
+#ifdef USE_INPUT_RECORDER
+    if (recorder_is_replaying()) {
+        return;
+    }
+#endif
+    // Press which restores dimmed scene is not a gesture
+    if (idle_input(button, is_pressed)) {
+        return;
+    }
+    RECORDER_PUT(is_pressed ? RECORDER_PRESS : RECORDER_RELEASE, button, time_us);
+    gesture_edge(button, is_pressed, time_us);
+}
+#endif
 
-// RF signal handler
-// External interrupt INT0 occurs every time receiver gets stable signal.
-void EXT_INT0_isr_handler() 
-{   
-    button_pressed_isr = true;
+
+
+#ifdef RFRX_ENABLED
+// RF remote
+// Learned code is one more source of buttons edges: the first accepted frame
+// is press, release is detected when remote stops to repeat frames.
+#define REMOTE_NONE     0xFF
+
+static uint8_t  remote_learning = REMOTE_NONE;   // button for the next learned code
+static uint8_t  remote_button = REMOTE_NONE;     // button which is held by remote
+static uint32_t remote_code;                     // code of held button
+
+// Release button held by remote if its frames are not repeated
+static void remote_check_release(uint32_t now_us)
+{
+    uint32_t last_us;
+    
+    if (remote_button == REMOTE_NONE) {
+        return;
+    }
+    last_us = BSP_rfrx_last_us();
+    if ((BSP_rfrx_last_code() != remote_code) || ((now_us - last_us) >= BSP_RFRX_REPEAT_US)) {
+        input_edge(remote_button, 0, last_us + BSP_RFRX_REPEAT_US);
+        remote_button = REMOTE_NONE;
+        failsafe_link_idle();
+    }
 }
 
+// Learning mode: codes are bound to buttons 0..3 in turn (the same chord again cancels it)
+static void remote_learn_stop(void)
+{
+    remote_learning = REMOTE_NONE;
+    BSP_timer_stop(TMR_REMOTE_LEARN);
+}
 
+// Called when learning timer (TMR_REMOTE_LEARN) is fired: no new codes, learning is left
+static void checkRemoteLearnTimeout(void)
+{
+    BSP_TRACE("RF learning is timed out at button %d", remote_learning);
+    remote_learning = REMOTE_NONE;
+}
 
-// Check if button was pressed
-// Number of the channel can be determined by reading receiver's pins (D0..D3)
-// If button is pressed - start timer and wait release
-void checkPressed() 
+static void remote_learn_restart(void)
 {
-    BSP_USE_CRITICAL();
-    uint8_t button_pressed_isr_local;
-    BSP_CRITICAL(button_pressed_isr_local = button_pressed_isr);
-        
-    // There was no ISR (there are pressed buttons)    
-    if(!button_pressed_isr_local) {
+    BSP_timer_start_ms(TMR_REMOTE_LEARN, SUIT_REMOTE_LEARN_MS, SWTIMER_SINGLE, checkRemoteLearnTimeout);
+}
+
+// Short blink of button LED (forward declaration)
+static void ledBlink(uint8_t led_number);
+#endif
+
+
+
+// Restart gesture timer (TMR_GESTURE) for the nearest gesture timeout
+static void gesture_timer_restart(uint32_t now_us)
+{
+    uint32_t left_us = gesture_next_timeout_us(now_us);
+    uint32_t left_ms;
+    
+#ifdef PCINT1_ENABLED
+    // Buttons debouncer takes samples by the same timer
+    uint32_t debounce_us = BSP_buttons_next_us(now_us);
+    
+    if (debounce_us && ((left_us == 0) || (debounce_us < left_us))) {
+        left_us = debounce_us;
+    }
+#endif
+    left_ms = (left_us + 999UL) / 1000UL;
+#ifdef RFRX_ENABLED
+    // Release of remote button is checked by the same timer
+    if ((remote_button != REMOTE_NONE) && ((left_ms == 0) || (left_ms > BSP_RFRX_REPEAT_US / 1000UL))) {
+        left_ms = BSP_RFRX_REPEAT_US / 1000UL;
+    }
+#endif
+    if (left_ms == 0) {
+        BSP_timer_stop(TMR_GESTURE);
+        // Recognizer is idle: time base is not needed until the next edge
+#ifdef USE_INPUT_RECORDER
+        if (recorder_is_replaying()) {
+            return;
+        }
+#endif
+        BSP_time_release(BSP_TIME_USER_INPUT);
         return;
-    }        
- 
+    }
+    if (left_ms < SWTIMERS_MIN_TIME) {
+        left_ms = SWTIMERS_MIN_TIME;
+    }
+    BSP_timer_start_ms(TMR_GESTURE, left_ms, SWTIMER_SINGLE, checkGestureTimeout);
+}
+
+
+
+// Init gesture recognizer
+void initButtons()
+{
+    gesture_init(&gesture_config);
+#ifdef RFRX_ENABLED
+    remote_init();
+    BSP_TRACE("Remote codes: %d", remote_count());
+#endif
+}
+
+
+
+#ifdef PCINT1_ENABLED
+// Take debouncer samples up to <now_us> and pass debounced edges to gesture recognizer.
+// Edges are passed in order of their timestamps: chords depend on the order of presses.
+static void buttons_debounce(uint32_t now_us)
+{
+    bspButtons_t btns;
+    uint8_t toggle;
+    
+    BSP_buttons_sample(now_us, &btns);
+    toggle = (btns.pressed | btns.released) & (BSP_BTN_MASK(GESTURE_BUTTONS_NUM) - 1);
     
-    for (uint8_t i = 0; i < 4; ++i) {
-        if ( ((i == 0) && BSP_BTN0_IS_PRESSED()) ||
-             ((i == 1) && BSP_BTN1_IS_PRESSED()) ||
-             ((i == 2) && BSP_BTN2_IS_PRESSED()) ||
-             ((i == 3) && BSP_BTN3_IS_PRESSED()) )    {
-            BSP_timer_start_ms(TMR_BTN_CHECK, SUIT_BUTTON_CHECK_MS, SWTIMER_PERIODIC, checkReleased);
-            BSP_TRACE("Button %d pressed", i);            
-            buttons[i].is_pressed = true;
-            buttons[i].event = BTN_WAIT_RELEASE;
-            // Don't sleep until event will be processed
-            i_can_sleep = 0;
+    while (toggle) {
+        uint8_t first = 0xFF;
+        
+        for (uint8_t i = 0; i < GESTURE_BUTTONS_NUM; ++i) {
+            if ((toggle & BSP_BTN_MASK(i)) && ((first == 0xFF) ||
+                ((int32_t)(BSP_buttons_edge_us(i) - BSP_buttons_edge_us(first)) < 0))) {
+                first = i;
+            }
         }
+        toggle &= ~BSP_BTN_MASK(first);
+        input_edge(first, (btns.pressed & BSP_BTN_MASK(first)) != 0, BSP_buttons_edge_us(first));
     }
     
-    BSP_CRITICAL(button_pressed_isr = false;);
+    if (btns.pressed) {
+        // Don't sleep until event will be processed
+        i_can_sleep = 0;
+    }
 }
+#endif
 
 
 
-// Called when check button timer (TMR_BTN_CHECK) is fired
-// Check if button was pressed earlier and released just now
-void checkReleased() 
+// Called when gesture timer (TMR_GESTURE) is fired
+// Holds, repeats and the end of clicks sequences are recognized by time
+void checkGestureTimeout() 
+{
+    uint32_t now_us = BSP_time_us();
+    
+#ifdef PCINT1_ENABLED
+    buttons_debounce(now_us);
+#endif
+#ifdef RFRX_ENABLED
+    remote_check_release(now_us);
+#endif
+    gesture_timeout(now_us);
+    gesture_timer_restart(now_us);
+}
+
+
+
+// Called when pin change is captured (BSP_EVENT_PCINT)
+// Captured port values are debounced, press and release moments are taken from 
+// edges timestamps and passed to gesture recognizer
+void checkButtons() 
 {   
-    for (uint8_t i = 0; i < 4; ++i) {
-        if (buttons[i].event != BTN_WAIT_RELEASE) {
+#ifdef PCINT1_ENABLED
+    bspPcintEdge_t edge;
+    uint32_t now_us;
+    
+    while (BSP_pcint_get(&edge)) {
+        buttons_debounce(edge.time_us);     // samples before this edge
+        BSP_buttons_capture(edge.pins, edge.time_us);
+    }
+    
+    now_us = BSP_time_us();
+    buttons_debounce(now_us);
+    gesture_timer_restart(now_us);
+#endif
+}
+
+
+
+
+#ifdef RFRX_ENABLED
+// Called when RF code is received (BSP_EVENT_RFRX)
+// Learned codes press their buttons, in learning mode codes are bound to buttons 0..3 in turn
+void checkRemote()
+{
+    bspRfrxCode_t rf;
+    uint32_t now_us;
+    
+    while (BSP_rfrx_get(&rf)) {
+        uint8_t button;
+        
+        if (remote_learning != REMOTE_NONE) {
+            if (remote_learn(rf.code, remote_learning)) {
+                BSP_TRACE("RF code 0x%06lX learned for button %d", rf.code, remote_learning);
+                ledBlink(remote_learning);
+                if (++remote_learning >= GESTURE_BUTTONS_NUM) {
+                    remote_learn_stop();
+                }
+                else {
+                    remote_learn_restart();
+                }
+            }
+            else {
+                BSP_TRACE("RF codes table is full", 0);
+                remote_learn_stop();
+            }
             continue;
         }
-                    
-        if ( ((i == 0) && (! BSP_BTN0_IS_PRESSED())) ||
-             ((i == 1) && (! BSP_BTN1_IS_PRESSED())) ||
-             ((i == 2) && (! BSP_BTN2_IS_PRESSED())) ||
-             ((i == 3) && (! BSP_BTN3_IS_PRESSED())) )    {
-            BSP_timer_stop(TMR_BTN_CHECK);
-            BSP_TRACE("Button released", 0);
-            buttons[i].is_pressed = false;
-            buttons[i].counter = 0;
-            buttons[i].event = BTN_SHORT_CLICK;  // short click detected
-        }
-        else if (buttons[i].counter * SUIT_BUTTON_CHECK_MS >= SUIT_BUTTON_LONG_MS) {
-            BSP_timer_stop(TMR_BTN_CHECK);
-            BSP_TRACE("Button timeout (counter %d)", buttons[0].counter);
-            buttons[i].is_pressed = false;
-            buttons[i].counter = 0;
-            buttons[i].event = BTN_LONG_CLICK;   // time is over - long click detected
+        
+        button = remote_find(rf.code);
+        if (button == REMOTE_NOT_FOUND) {
+            BSP_TRACE("RF code 0x%06lX is unknown", rf.code);
+            continue;
         }
-        else {
-            buttons[i].counter++;
+        
+        // Another remote button: release previous one at once
+        if (remote_button != REMOTE_NONE) {
+            input_edge(remote_button, 0, rf.time_us);
         }
-    }   
+        input_edge(button, 1, rf.time_us);
+        remote_button = button;
+        remote_code = rf.code;
+        failsafe_link_alive();
+        
+        // Don't sleep until event will be processed
+        i_can_sleep = 0;
+    }
+    
+    now_us = BSP_time_us();
+    remote_check_release(now_us);
+    gesture_timer_restart(now_us);
 }
+#endif
 
 
 
-
-void processButtonEvent()
+#ifdef USE_INPUT_RECORDER
+// Called when replay timer (TMR_REPLAY) is fired
+// Edges are passed with their recorded timestamps (shifted to replay time), timeouts 
+// between edges are processed at their deadlines: gestures are the same as recorded.
+void checkReplay()
 {
+    recorder_event_t ev;
+    uint32_t now_us = BSP_time_us();
+    uint32_t left_ms;
     
-    if (buttons[0].event == BTN_SHORT_CLICK) {
-        buttons[0].event = BTN_NO_EVENT;
-        BSP_TRACE("Helmet short click", 0);
-        helmet_move = true;
-    }
-    else if (buttons[0].event == BTN_LONG_CLICK) {
-        buttons[0].event = BTN_NO_EVENT;
-        BSP_TRACE("Helmet long click", 0);
-        helmet_move = true;
-    }   
-
-    if (buttons[1].event == BTN_SHORT_CLICK) {
-        buttons[1].event = BTN_NO_EVENT;
-        BSP_TRACE("Eyes/Chest short click", 0);
-        eyes_toggle = true;
-    }
-    else if (buttons[1].event == BTN_LONG_CLICK) {
-        buttons[1].event = BTN_NO_EVENT;
-        BSP_TRACE("Eyes/Chest long click", 0);
-        chest_toggle = true;
-    }
-     
-    if (buttons[2].event == BTN_SHORT_CLICK) {
-        buttons[2].event = BTN_NO_EVENT;
-        BSP_TRACE("Left hand short click", 0);
-        left_toggle = true;
+    while (recorder_replay_get(now_us, &ev)) {
+        gesture_timeout(ev.time_us);
+        gesture_edge(ev.data, ev.type == RECORDER_PRESS, ev.time_us);
     }
-    else if (buttons[2].event == BTN_LONG_CLICK) {
-        buttons[2].event = BTN_NO_EVENT;
-        BSP_TRACE("Left hand long click", 0);
-        left_effect = true;
+    gesture_timer_restart(now_us);
+    
+    if (!recorder_is_replaying()) {
+        BSP_TRACE("Replay is finished", 0);
+        gesture_timer_restart(now_us);   // time base is released if gestures are finished
+        return;
     }
-         
-    if (buttons[3].event == BTN_SHORT_CLICK) {
-        buttons[3].event = BTN_NO_EVENT;
-        BSP_TRACE("Right hand short click", 0);
-        right_toggle = true;
+    left_ms = (recorder_replay_next_us(now_us) + 999UL) / 1000UL;
+    if (left_ms < SWTIMERS_MIN_TIME) left_ms = SWTIMERS_MIN_TIME;
+    if (left_ms > SWTIMERS_MAX_TIME) left_ms = SWTIMERS_MAX_TIME;
+    BSP_timer_start_ms(TMR_REPLAY, left_ms, SWTIMER_SINGLE, checkReplay);
+}
+#endif
+
+
+
+// Forward declaration
+static void processAction(suit_action_t action);
+
+// Get recognized gestures, find actions in dispatch table and run them
+void processButtonEvent()
+{
+    gesture_event_t gesture;
+    suit_action_t action;
+    
+    uint8_t is_active = 0;
+    
+    while (gesture_get(&gesture)) {
+        RECORDER_PUT(RECORDER_GESTURE, (gesture.type << 4) | gesture.buttons, BSP_time_us());
+        suit_action_find(gesture.buttons, gesture.type, &action);
+        BSP_TRACE("Gesture %d buttons 0x%02X action %d", gesture.type, gesture.buttons, action.type);
+        processAction(action);
+        is_active = 1;
     }
-    else if (buttons[3].event == BTN_LONG_CLICK) {
-        buttons[3].event = BTN_NO_EVENT;
-        BSP_TRACE("Right hand long click", 0);
-        right_effect = true;
+    
+    // Idle time is counted from the last gesture
+    if (is_active) {
+        idle_restart();
     }
-
 }
 
 
@@ -357,24 +814,51 @@ static void ledFadeOff(uint8_t led_number, uint16_t time_ms)
 #endif    
 
 #define SERVO_GRADATIONS ((SUIT_SERVO1_OPEN_US - SUIT_SERVO1_CLOSE_US) / SERVO_GRADATION_US)
+#define SERVO_STEP_MS    20      // one gradation per servo frame
 
 
 static bool helmet_is_open = 1;
+static volatile uint8_t helmet_step_idx;    // next gradation of helmet motion
 
 
-ISR (TIMER1_OVF_vect) {
+// Frame start (interrupt context)
+static void servo_frame_start(void) {
     BSP_LED6_ON();
     BSP_LED7_ON(); 
 }
     
-ISR (TIMER1_COMPA_vect) {
+ISR (TIME_COMPA_VECTOR) {
+    BSP_LATENCY_SAMPLE(BSP_LATENCY_TIMER1_COMPA, (uint16_t)(TCNT1 - OCR1A) << bsp_time_shift);
     BSP_LED6_OFF(); 
 }
 
-ISR (TIMER1_COMPB_vect) {
+ISR (TIME_COMPB_VECTOR) {
+    BSP_LATENCY_SAMPLE(BSP_LATENCY_TIMER1_COMPB, (uint16_t)(TCNT1 - OCR1B) << bsp_time_shift);
     BSP_LED7_OFF(); 
 }
 
+// Helmet motion step (TMR_HELMET handler, timer ISR context)
+// Steps don't depend on main loop and busy-wait delays. Comparators are written with
+// interrupts disabled already; timer is stopped one period after the last gradation.
+static void helmet_step(void)
+{
+    uint8_t i = helmet_step_idx;
+    
+    if (i > SERVO_GRADATIONS) {
+        BSP_timer_stop(TMR_HELMET);
+        return;
+    }
+    if (helmet_is_open) {
+        BSP_TIME_COMPARE_A_SET(SUIT_SERVO1_OPEN_US - i * SERVO_GRADATION_US);
+        BSP_TIME_COMPARE_B_SET(SUIT_SERVO2_OPEN_US + i * SERVO_GRADATION_US);
+    }
+    else {
+        BSP_TIME_COMPARE_A_SET(SUIT_SERVO1_CLOSE_US + i * SERVO_GRADATION_US);
+        BSP_TIME_COMPARE_B_SET(SUIT_SERVO2_CLOSE_US - i * SERVO_GRADATION_US);
+    }
+    helmet_step_idx = i + 1;
+}
+
 
 
 static void helmet_toggle() 
@@ -394,49 +878,42 @@ static void helmet_toggle()
     BSP_LED6_OFF();
     BSP_LED7_OFF();
 
-    // Stop timer
-    TCCR1B = 0;
-
-    // TOP for Fast PWM = 20000. Full cycle (up-down) 20000*1us = 20000us
-    ICR1 = 20000;
-    
     // Comparator Servo 1 and 2
+    // Time base frame is the servo period, timer is not reconfigured
+    BSP_time_hold(BSP_TIME_USER_SERVO);
+    // (16-bit registers are shared with interrupts - write them in critical section)
     if (helmet_is_open) {
-        OCR1A = SUIT_SERVO1_OPEN_US;
-        OCR1B = SUIT_SERVO2_OPEN_US;
+        BSP_CRITICAL(BSP_TIME_COMPARE_A_SET(SUIT_SERVO1_OPEN_US); BSP_TIME_COMPARE_B_SET(SUIT_SERVO2_OPEN_US));
     }
     else {
-        OCR1A = SUIT_SERVO1_CLOSE_US;
-        OCR1B = SUIT_SERVO2_CLOSE_US;
+        BSP_CRITICAL(BSP_TIME_COMPARE_A_SET(SUIT_SERVO1_CLOSE_US); BSP_TIME_COMPARE_B_SET(SUIT_SERVO2_CLOSE_US));
     }
 
-    // Interrupts for timer
-    TIMSK1 = (1<<TOIE1) | (1<<OCIE1A) | (1<<OCIE1B);
-    // Fast (from 0 to ICR1)
-    // Prescaler 1MHz/1 = 1us
-    TCCR1A = (1<<WGM11);
-    TCCR1B = (1<<WGM12) | (1<<WGM13) | (1<<CS10);
+    // Pulses start at frame start, end at comparators match
+    BSP_time_set_frame_handler(servo_frame_start);
+    BSP_CRITICAL(TIME_COMPARES_ON());
     
     
     // Turn on Servo power
     BSP_LED4_ON();
  
  
-   for (uint8_t i = 0; i <= SERVO_GRADATIONS; ++i) {
-        // Comparator Servo 1 and 2
-        if (helmet_is_open) {
-            OCR1A = SUIT_SERVO1_OPEN_US - i * SERVO_GRADATION_US;
-            OCR1B = SUIT_SERVO2_OPEN_US + i * SERVO_GRADATION_US;
-        }
-        else {
-            OCR1A = SUIT_SERVO1_CLOSE_US + i * SERVO_GRADATION_US;
-            OCR1B = SUIT_SERVO2_CLOSE_US - i * SERVO_GRADATION_US;
-        }
-        _delay_ms(20);
+    // Gradation 0 is set above, the next ones are set by async timer, one per period.
+    // CPU sleeps until the last gradation is held for one period and timer is stopped
+    // (any interrupt wakes it up, servo frames come every 20ms).
+    helmet_step_idx = 1;
+    BSP_timer_start_ms(TMR_HELMET, SERVO_STEP_MS, SWTIMER_PERIODIC_ASYNC, helmet_step);
+    BSP_ALL_INT_DISABLE();
+    while (BSP_timer_is_run(TMR_HELMET)) {
+        SLEEP_IDLE_MODE_SEI();
+        BSP_ALL_INT_DISABLE();
     }
+    BSP_ALL_INT_ENABLE();
 
-    // Stop timer
-    TCCR1B = 0;
+    // Stop pulses
+    BSP_time_set_frame_handler(NULL);
+    BSP_CRITICAL(TIME_COMPARES_OFF());
+    BSP_time_release(BSP_TIME_USER_SERVO);
 
     // Servo signals low
     BSP_LED6_OFF();
@@ -458,61 +935,381 @@ static void helmet_toggle()
     else                helmet_is_open = true; 
 }
 
+
+
+#ifdef RCIN_ENABLED
+// Move helmet to position 0 (closed) .. BSP_RCIN_POS_MAX (open).
+// Pulses are started once and left running: servos follow the stick every frame.
+static bool helmet_rc_active = false;
+
+static void helmet_set_position(uint8_t pos)
+{
+    uint16_t offset_us = (uint32_t)pos * (SUIT_SERVO1_OPEN_US - SUIT_SERVO1_CLOSE_US) / BSP_RCIN_POS_MAX;
+
+    BSP_USE_CRITICAL();
+
+    BSP_time_hold(BSP_TIME_USER_SERVO);
+    BSP_CRITICAL(BSP_TIME_COMPARE_A_SET(SUIT_SERVO1_CLOSE_US + offset_us);
+                 BSP_TIME_COMPARE_B_SET(SUIT_SERVO2_CLOSE_US - offset_us));
+
+    if (!helmet_rc_active) {
+        helmet_rc_active = true;
+        BSP_time_set_frame_handler(servo_frame_start);
+        BSP_CRITICAL(TIME_COMPARES_ON());
+        // Turn on Servo power
+        BSP_LED4_ON();
+    }
+    helmet_is_open = (pos > BSP_RCIN_POS_MAX / 2);
+}
+
+// Called when RC channel pulse is measured (BSP_EVENT_RCIN)
+// Filtered position is applied at once: helmet is one frame behind the stick
+void checkRcInput()
+{
+    if (BSP_rcin_width_us(SUIT_RC_HELMET_CHAN) == 0) {
+        return;
+    }
+    failsafe_link_alive();
+    helmet_set_position(BSP_rcin_position(SUIT_RC_HELMET_CHAN));
+}
+
+// Stop servo pulses, cut servo power
+static void helmet_stop(void)
+{
+    BSP_USE_CRITICAL();
+
+    BSP_time_set_frame_handler(NULL);
+    BSP_CRITICAL(TIME_COMPARES_OFF());
+    BSP_time_release(BSP_TIME_USER_SERVO);
+    BSP_LED6_OFF();
+    BSP_LED7_OFF();
+    BSP_LED4_OFF();
+    helmet_rc_active = false;
+}
+#endif
+
+
 // ****************************************************************************
 // Change effects state
 // ****************************************************************************
-void processEffects()
-{     
+// Fading time [ms] of suit LEDs (eyes are faster)
+#define SUIT_LED_FADE_MS(led)   (((led) == 0) ? 500 : 1000)
+
+// Toggle one suit LED with fading
+static void ledFadeToggle(uint8_t led_number)
+{
+    bool is_on;
     
-    if (helmet_move) {      // Helmet open/close
-        helmet_move = false;
-		helmet_toggle();
-        BSP_TRACE("Event (helmet_move) processed", 0);    
+    switch (led_number) {
+        case 0:  is_on = BSP_LED0_IS_ON(); break;
+        case 1:  is_on = BSP_LED1_IS_ON(); break;
+        case 2:  is_on = BSP_LED2_IS_ON(); break;
+        case 3:  is_on = BSP_LED3_IS_ON(); break;
+        default: return;
     }
- 
-    if (eyes_toggle) {      // Just toggle eye LEDs
-        eyes_toggle = false;       
-        if (BSP_LED0_IS_ON())  ledFadeOff(0, 500);
-        else                   ledFadeOn(0, 500);
-        BSP_TRACE("Event (eyes_toggle) processed", 0);
+    
+    if (is_on) ledFadeOff(led_number, SUIT_LED_FADE_MS(led_number));
+    else       ledFadeOn(led_number, SUIT_LED_FADE_MS(led_number));
+}
+
+#ifdef RFRX_ENABLED
+// Short blink of one suit LED (inverted for SUIT_REMOTE_BLINK_MS), its state is kept
+static void ledBlink(uint8_t led_number)
+{
+    for (uint8_t i = 0; i < 2; ++i) {
+        switch (led_number) {
+            case 0: BSP_LED0_TOGGLE(); break;
+            case 1: BSP_LED1_TOGGLE(); break;
+            case 2: BSP_LED2_TOGGLE(); break;
+            case 3: BSP_LED3_TOGGLE(); break;
+        }
+        if (i == 0) {
+            _delay_ms(SUIT_REMOTE_BLINK_MS);
+        }
     }
+}
+#endif
+
+// ****************************************************************************
+// Inactivity
+// ****************************************************************************
+// Sleep timer counts idle time while any suit LED is on. The first timeout
+// dims the scene to standby LEDs (LEDs have no brightness control, standby
+// is a subset of them), the second one switches the rest off and suit sleeps.
+// Scene is saved before dimming and restored at once by any press.
+typedef enum {
+    IDLE_ACTIVE,        // scene is as set by user
+    IDLE_STANDBY,       // only standby LEDs of the scene are on
+    IDLE_OFF,           // all LEDs are off, scene is saved
+} idle_stage_t;
+
+static idle_stage_t idle_stage = IDLE_ACTIVE;
+static uint8_t idle_scene;          // LEDs which were on before dimming (bit n - LED n)
+static uint8_t idle_swallowed;      // buttons which restored the scene: edges are dropped until release
+static uint8_t idle_timer_is_own;   // sleep timer counts idle time (it is shared with software timers)
+
+#define SUIT_LEDS_NUM   4
+
+// Suit LEDs which are on (bit n - LED n)
+static uint8_t suit_leds_get(void)
+{
+    return (BSP_LED0_IS_ON() ? (1 << 0) : 0) | (BSP_LED1_IS_ON() ? (1 << 1) : 0) |
+           (BSP_LED2_IS_ON() ? (1 << 2) : 0) | (BSP_LED3_IS_ON() ? (1 << 3) : 0);
+}
+
+// Set suit LEDs at once, without fading
+static void suit_leds_set(uint8_t leds)
+{
+    if (leds & (1 << 0)) { BSP_LED0_ON(); } else { BSP_LED0_OFF(); }
+    if (leds & (1 << 1)) { BSP_LED1_ON(); } else { BSP_LED1_OFF(); }
+    if (leds & (1 << 2)) { BSP_LED2_ON(); } else { BSP_LED2_OFF(); }
+    if (leds & (1 << 3)) { BSP_LED3_ON(); } else { BSP_LED3_OFF(); }
+}
+
+// Fade off suit LEDs from mask which are on
+static void suit_leds_fade_off(uint8_t leds)
+{
+    leds &= suit_leds_get();
+    for (uint8_t i = 0; i < SUIT_LEDS_NUM; ++i) {
+        if (leds & (1 << i)) {
+            ledFadeOff(i, SUIT_LED_FADE_MS(i));
+        }
+    }
+}
+
+static void idle_off(void);
+
+// Called when idle time is expired (sleep timer handler)
+static void idle_standby(void)
+{
+    idle_timer_is_own = 0;
+    idle_scene = suit_leds_get();
+    if (idle_scene == 0) {
+        return;
+    }
+    BSP_TRACE("Idle: standby", 0);
+    suit_leds_fade_off(idle_scene & ~SUIT_IDLE_STANDBY_LEDS);
+    idle_stage = IDLE_STANDBY;
+    
+    // Scene has no standby LEDs - it is off already
+    if (suit_leds_get() == 0) {
+        idle_stage = IDLE_OFF;
+        return;
+    }
+    idle_timer_is_own = 1;
+    BSP_sleep_timer_start_ms(SUIT_IDLE_OFF_MS, idle_off);
+}
+
+// Called when standby time is expired (sleep timer handler)
+static void idle_off(void)
+{
+    idle_timer_is_own = 0;
+    BSP_TRACE("Idle: off", 0);
+    suit_leds_fade_off(idle_scene);
+    idle_stage = IDLE_OFF;
+}
+
+// Count idle time from now if scene is lit
+static void idle_restart(void)
+{
+    if (suit_leds_get()) {
+        idle_timer_is_own = 1;
+        BSP_sleep_timer_start_ms(SUIT_IDLE_DIM_MS, idle_standby);
+    }
+    else if (idle_timer_is_own) {
+        idle_timer_is_own = 0;
+        BSP_sleep_timer_stop();
+    }
+}
+
+#if defined(PCINT1_ENABLED) || defined(RFRX_ENABLED)
+// Input edge: restore dimmed scene on press. Returns 1 if edge is consumed.
+static uint8_t idle_input(uint8_t button, uint8_t is_pressed)
+{
+    uint8_t mask = (1 << button);
     
-    if (chest_toggle) {     // Just toggle chest led
-        chest_toggle = false;
-        if (BSP_LED1_IS_ON())  ledFadeOff(1, 1000);
-        else                   ledFadeOn(1, 1000);
-        BSP_TRACE("Event (chest_toggle) processed", 0);
+    if (idle_swallowed & mask) {
+        if (!is_pressed) {
+            idle_swallowed &= ~mask;
+        }
+        return 1;
+    }
+    if (!is_pressed || (idle_stage == IDLE_ACTIVE)) {
+        return 0;
+    }
+    suit_leds_set(idle_scene);
+    idle_stage = IDLE_ACTIVE;
+    idle_swallowed |= mask;
+    idle_restart();
+    BSP_TRACE("Idle: scene 0x%02X is restored", idle_scene);
+    return 1;
+}
+#endif
+
+// Run one action
+static void processAction(suit_action_t action)
+{     
+    switch (action.type) {
+        case SUIT_ACTION_HELMET_TOGGLE:
+            helmet_toggle();
+            break;
+        case SUIT_ACTION_LED_TOGGLE:
+            ledFadeToggle(action.arg);
+            break;
+        case SUIT_ACTION_LEDS_ON:
+            SUIT_LEDS_ON();
+            break;
+        case SUIT_ACTION_LEDS_OFF:
+            SUIT_LEDS_OFF();
+            break;
+        case SUIT_ACTION_AMBIENT_TOGGLE:
+            ambient_is_on = !ambient_is_on;
+            break;
+#ifdef USE_ENERGY_METER
+        case SUIT_ACTION_ENERGY_DUMP:
+            energy_dump();
+            break;
+#endif
+#ifdef USE_INPUT_RECORDER
+        case SUIT_ACTION_RECORDER_DUMP:
+            recorder_dump();
+            break;
+        case SUIT_ACTION_RECORDER_REPLAY:
+            // Replayed chord of replay is ignored
+            if (recorder_is_replaying()) {
+                return;
+            }
+            BSP_TRACE("Replay is started", 0);
+            gesture_init(&gesture_config);   // replay starts from idle buttons
+            BSP_time_hold(BSP_TIME_USER_INPUT);
+            recorder_replay_start(BSP_time_us());
+            BSP_timer_start_ms(TMR_REPLAY, RECORDER_REPLAY_DELAY_MS, SWTIMER_SINGLE, checkReplay);
+            break;
+#endif
+#ifdef RFRX_ENABLED
+        case SUIT_ACTION_REMOTE_LEARN:
+            if (remote_learning != REMOTE_NONE) {
+                BSP_TRACE("RF learning is canceled", 0);
+                remote_learn_stop();
+                break;
+            }
+            remote_learning = 0;
+            remote_learn_restart();
+            break;
+        case SUIT_ACTION_REMOTE_FORGET:
+            remote_forget_all();
+            break;
+#endif
+        default:
+            return;
     }
-   
-    if (left_toggle) {      // Just toggle left hand LED
-        left_toggle = false;
-        if (BSP_LED2_IS_ON())  ledFadeOff(2, 1000);
-        else                   ledFadeOn(2, 1000);
-        BSP_TRACE("Event (left_toggle) processed", 0);  
+    BSP_TRACE("Action %d (%d) processed", action.type, action.arg);
+}
+
+#if defined(RFRX_ENABLED) || defined(RCIN_ENABLED)
+// ****************************************************************************
+// Failsafe
+// ****************************************************************************
+// Link is monitored by one software timer. It is not restarted by frames:
+// when it fires, silence time is taken from the last valid frame timestamp and
+// timer is restarted for the rest of timeout. Healthy link costs one compare per frame.
+// RF remote is silent between presses: it is monitored only while its button is held.
+typedef enum {
+    FAILSAFE_IDLE,      // no link yet (or lost), timer is stopped
+    FAILSAFE_OK,        // link is alive, timer waits for timeout
+    FAILSAFE_PARKING,   // link is lost, servos are driven to park position
+} failsafe_state_t;
+
+static failsafe_state_t failsafe_state = FAILSAFE_IDLE;
+
+#if (SUIT_FAILSAFE_MS > SWTIMERS_MAX_TIME)
+    #error "SUIT_FAILSAFE_MS is too long for software timer"
+#endif
+
+
+// Time of the last valid frame
+static uint32_t failsafe_last_us(void)
+{
+#ifdef RCIN_ENABLED
+    return BSP_rcin_last_us();
+#else
+    return BSP_rfrx_last_us();
+#endif
+}
+
+// Link is alive: start monitor if it is not started
+static void failsafe_link_alive(void)
+{
+    if (failsafe_state == FAILSAFE_OK) {
+        return;
     }
+    failsafe_state = FAILSAFE_OK;
+    BSP_timer_start_ms(TMR_FAILSAFE, SUIT_FAILSAFE_MS, SWTIMER_SINGLE, checkFailsafe);
+}
 
-    if (left_effect) {      // Toggle left hand LED with effect
-        left_effect = false;
-        if (BSP_LED2_IS_ON())  ledFadeOff(2, 1000);
-        else                   ledFadeOn(2, 1000);
-        BSP_TRACE("Event (left_effect) processed", 0);
+#ifdef RFRX_ENABLED
+// Remote button is released: stop monitor
+static void failsafe_link_idle(void)
+{
+    if (failsafe_state == FAILSAFE_OK) {
+        BSP_timer_stop(TMR_FAILSAFE);
+        failsafe_state = FAILSAFE_IDLE;
     }
+}
+#endif
+
+// Called when failsafe timer (TMR_FAILSAFE) is fired
+void checkFailsafe()
+{
+    if (failsafe_state == FAILSAFE_OK) {
+        uint32_t silent_ms = (BSP_time_us() - failsafe_last_us()) / 1000UL;
     
-    if (right_toggle) {      // Just toggle right hand LED
-        right_toggle = false;
-        if (BSP_LED3_IS_ON())  ledFadeOff(3, 1000);
-        else                   ledFadeOn(3, 1000);
-        BSP_TRACE("Event (right_toggle) processed", 0); 
+        if (silent_ms < SUIT_FAILSAFE_MS) {
+            uint32_t left_ms = SUIT_FAILSAFE_MS - silent_ms;
+            if (left_ms < SWTIMERS_MIN_TIME) {
+                left_ms = SWTIMERS_MIN_TIME;
+            }
+            BSP_timer_start_ms(TMR_FAILSAFE, left_ms, SWTIMER_SINGLE, checkFailsafe);
+            return;
+        }
+        BSP_TRACE("Link is lost: safe state", 0);
+    
+        if (SUIT_FAILSAFE_MODE & SUIT_FAILSAFE_LEDS_OFF) {
+            if (BSP_LED0_IS_ON()) ledFadeOff(0, SUIT_LED_FADE_MS(0));
+            if (BSP_LED1_IS_ON()) ledFadeOff(1, SUIT_LED_FADE_MS(1));
+            if (BSP_LED2_IS_ON()) ledFadeOff(2, SUIT_LED_FADE_MS(2));
+            if (BSP_LED3_IS_ON()) ledFadeOff(3, SUIT_LED_FADE_MS(3));
+        }
+#ifdef RFRX_ENABLED
+        if ((SUIT_FAILSAFE_MODE & SUIT_FAILSAFE_REMOTE_UP) && (remote_button != REMOTE_NONE)) {
+            input_edge(remote_button, 0, failsafe_last_us() + BSP_RFRX_REPEAT_US);
+            remote_button = REMOTE_NONE;
+        }
+#endif
+#ifdef RCIN_ENABLED
+        if ((SUIT_FAILSAFE_MODE & SUIT_FAILSAFE_SERVOS_PARK) && helmet_rc_active) {
+            helmet_set_position(0);
+            failsafe_state = FAILSAFE_PARKING;
+            BSP_timer_start_ms(TMR_FAILSAFE, SUIT_FAILSAFE_PARK_MS, SWTIMER_SINGLE, checkFailsafe);
+            return;
+        }
+#endif
     }
-       
-    if (right_effect) {      // Toggle right hand LED with effect
-        right_effect = false;
-        if (BSP_LED3_IS_ON())  ledFadeOff(3, 1000);
-        else                   ledFadeOn(3, 1000);
-        BSP_TRACE("Event (right_effect) processed", 0);
+    
+    // Servos are parked (or were not driven)
+#ifdef RCIN_ENABLED
+    if (SUIT_FAILSAFE_MODE & SUIT_FAILSAFE_SERVOS_OFF) {
+        helmet_stop();
     }
+#endif
+    failsafe_state = FAILSAFE_IDLE;
+}
+#endif
 
- 
+
+
+void processEffects()
+{     
     // Sleep only if all LEDs are switched off
     if ((i_can_sleep == 0) && (!BSP_LED0_IS_ON()) && (!BSP_LED1_IS_ON()) && (!BSP_LED2_IS_ON()) && (!BSP_LED3_IS_ON())) {
         i_can_sleep = 1;   
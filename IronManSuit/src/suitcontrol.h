@@ -11,11 +11,88 @@
 // ****************************************************************************
 // Suit settings
 // ****************************************************************************
-// Period to check button for release, after it was pressed.
-#define SUIT_BUTTON_CHECK_MS        100UL 
-
-// If button is pressed longer than this time - that means long click. Release moment does not matter.
-#define SUIT_BUTTON_LONG_MS         1500UL
+// Buttons gestures thresholds [ms]
+#define SUIT_GESTURE_GLITCH_MS      20      // press must be stable this time, shorter one is a receiver glitch
+#define SUIT_GESTURE_REFRACTORY_MS  100     // presses are ignored after a glitch
+#define SUIT_GESTURE_GAP_MS         400     // the longest pause between clicks of double/triple click
+#define SUIT_GESTURE_HOLD_MS        1500    // longer press is a hold (long click). Release moment does not matter.
+#define SUIT_GESTURE_REPEAT_MS      500     // hold repeat period
+#define SUIT_GESTURE_CHORD_MS       200     // the longest delay between presses of two buttons chord
+
+
+// RF remote codes learning (RFRX_ENABLED): learning is left if there is no new code
+// for this time, each stored code blinks LED of its button
+#define SUIT_REMOTE_LEARN_MS        10000UL
+#define SUIT_REMOTE_BLINK_MS        150
+
+// RC receiver channels (RCIN_ENABLED)
+#define SUIT_RC_HELMET_CHAN         0       // stick moves helmet proportionally
+#define SUIT_RC_CHANNELS_MASK       (1 << SUIT_RC_HELMET_CHAN)
+
+
+// Failsafe on link loss (RFRX_ENABLED or RCIN_ENABLED)
+#ifdef RCIN_ENABLED
+    #define SUIT_FAILSAFE_MS        500     // RC receiver sends frames all the time
+#else
+    #define SUIT_FAILSAFE_MS        1000    // RF remote repeats codes only while button is held: link is
+                                            // monitored only then, silent remote is not a link loss
+#endif
+#define SUIT_FAILSAFE_PARK_MS       1000    // time to drive servos to park position before power off
+
+// Safe state (bit mask)
+#define SUIT_FAILSAFE_LEDS_OFF      (1 << 0)    // fade all suit LEDs off
+#define SUIT_FAILSAFE_SERVOS_PARK   (1 << 1)    // close helmet if servos are driven
+#define SUIT_FAILSAFE_SERVOS_OFF    (1 << 2)    // stop servo pulses, cut servo power
+#define SUIT_FAILSAFE_REMOTE_UP     (1 << 3)    // release button held by RF remote
+#ifdef RCIN_ENABLED
+    #define SUIT_FAILSAFE_MODE      (SUIT_FAILSAFE_LEDS_OFF | SUIT_FAILSAFE_SERVOS_PARK | SUIT_FAILSAFE_SERVOS_OFF)
+#else
+    #define SUIT_FAILSAFE_MODE      (SUIT_FAILSAFE_REMOTE_UP)
+#endif
+
+
+// Ambient animation in sleep: arc reactor pulse on chest LED (AMBIENT_LED)
+#define SUIT_AMBIENT_STEP_FRAMES    4       // frames (1/128 s) per brightness level, 64 levels - 2 s pulse
+
+// Debug output for each sleep and wake-up. UART is drained before sleep: 
+// at 2400 baud it keeps MCU awake ~170 ms per wake-up.
+//#define SUIT_SLEEP_DEBUG
+
+// Clock scaling (CLOCK_SCALING_ENABLED): slow clock is selected only if the nearest
+// software timer deadline is farther (each change retunes timers, UART and ADC)
+#define SUIT_CLOCK_SLOW_IDLE_MS     500
+
+
+// Inactivity: after idle time lit scene is dimmed to standby LEDs, then it is
+// switched off and suit sleeps. Any input restores the scene.
+#define SUIT_IDLE_DIM_MS            120000UL    // idle time before standby
+#define SUIT_IDLE_OFF_MS            60000UL     // standby time before off
+#define SUIT_IDLE_STANDBY_LEDS      (1 << 0)    // LEDs left on in standby (bit n - LED n), eyes
+
+
+// Battery monitor (BATTERY_ENABLED)
+#define SUIT_BATTERY_PERIOD_MS      60000UL     // measurement period
+#define SUIT_BATTERY_LOW_MV         3400        // lower voltage is reported as low
+
+
+// ADC reference calibration (factory firmware only): board is powered from bench supply
+// of SUIT_ADC_CAL_VCC_MV, button is held at power-up. Reference is saved to EEPROM for good.
+//#define SUIT_ADC_FACTORY_CAL
+#define SUIT_ADC_CAL_VCC_MV         3300
+#define SUIT_ADC_CAL_BUTTON         3           // right hand
+#define SUIT_ADC_CAL_HOLD_MS        3000        // button must be held all this time after power-up
+
+
+// Energy meter (USE_ENERGY_METER): currents of loads [uA]
+#define SUIT_ENERGY_EYES_UA         20000UL
+#define SUIT_ENERGY_CHEST_UA        20000UL
+#define SUIT_ENERGY_HAND_UA         20000UL     // each hand
+#define SUIT_ENERGY_SERVOS_UA       500000UL    // two servos in motion
+#define SUIT_ENERGY_CPU_ACTIVE_UA   500UL       // 1 MHz
+#define SUIT_ENERGY_CPU_IDLE_UA     150UL
+#define SUIT_ENERGY_CPU_ACTIVE_SLOW_UA  150UL   // 250 kHz (CLOCK_SCALING_ENABLED)
+#define SUIT_ENERGY_CPU_IDLE_SLOW_UA    50UL
+#define SUIT_ENERGY_CPU_SAVE_UA     5UL         // Timer2 and wake-ups for ambient frames
 
 
 // PWM for servo
@@ -34,16 +111,43 @@
 // ****************************************************************************
 
 // Read buttons state and process
-void checkPressed();
-void checkReleased();
+void initButtons();
+void checkButtons();
+void checkGestureTimeout();
 void processButtonEvent();
 
+// Process received RF codes (RFRX_ENABLED)
+void checkRemote();
+
+// Process RC receiver channels (RCIN_ENABLED)
+void checkRcInput();
+
+// Called when failsafe timer (TMR_FAILSAFE) is fired
+void checkFailsafe();
+
+// Called when replay timer (TMR_REPLAY) is fired (USE_INPUT_RECORDER)
+void checkReplay();
+
+// Called when battery timer (TMR_BATTERY) is fired (BATTERY_ENABLED)
+void checkBattery();
+
+// Calibrate ADC reference if calibration button is held at power-up (SUIT_ADC_FACTORY_CAL)
+void checkAdcCalibration();
+
 // Change effects state
 void processEffects();
 
 // Check state and go to the sleep mode
 void processSleep();
 
+// Select system clock for waiting the next event (CLOCK_SCALING_ENABLED)
+void processClock();
+
+// Energy meter (USE_ENERGY_METER): clear counters, charge time after previous call
+// to loads which are on and to CPU state <cpu_load> (energy_load_t) at current system clock
+void initEnergy();
+void processEnergy(uint8_t cpu_load);
+
 
 
 